@@ -0,0 +1,345 @@
+// Allocation of the large search tables, and the solver contexts that recycle them
+//
+// The search writes to its tables at offsets a coin apart, so once a table is more than a few megabytes nearly
+// every access needs a TLB walk of its own.  Tables of at least a huge page are therefore mapped directly, aligned
+// to a huge page boundary, and either advised for transparent huge pages or taken from the hugetlbfs pool.  If
+// the pool is empty we fall back to transparent huge pages, and if the kernel won't give us those the mapping just
+// stays backed by small pages.  Small tables come from calloc() as they always have
+//
+// A solver context keeps the tables of finished queries in a small pool, so that the next query of a similar size
+// reuses pages that are already faulted in rather than mapping and faulting a fresh set.  Everything else a query
+// allocates, such as its result, is bump-allocated from the context's arena and released in bulk by a reset
+//
+// Author: Stew Forster (stew675@gmail.com)
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "mincoins_int.h"
+
+#define HUGE_PAGE_SIZE	(2UL * 1024 * 1024)
+#define GUARD_SIZE	4096UL
+#define ARENA_CHUNK	(64UL * 1024)
+#define POOL_SLOTS	4
+
+typedef struct arena_chunk {
+	struct arena_chunk	*next;
+	size_t			size;
+	size_t			used;
+	uint8_t			data[];
+} arena_chunk_t;
+
+// A solver context is used by one thread at a time
+struct minc_solver {
+	arena_chunk_t	*chunks;		// In the order they were added
+	arena_chunk_t	*current;		// Where the next allocation is tried first.  Those before it are full
+	uint32_t	n_pooled;
+	struct {
+		table_t	table;
+		int	clean;			// Every entry is zero, so it can serve as a totals table
+	} pool[POOL_SLOTS];
+};
+
+int minc_hugepages = MINC_HUGE_THP;
+
+static const char *hugepage_names[] = { "off", "thp", "hugetlb" };
+
+
+// Select how large tables are backed by name.  Returns -1 if the name isn't known
+int
+minc_set_hugepages(const char *name)
+{
+	for (int m = MINC_HUGE_OFF; m <= MINC_HUGE_HUGETLB; m++) {
+		if (strcmp(name, hugepage_names[m]) == 0) {
+			minc_hugepages = m;
+			return 0;
+		}
+	}
+	return -1;
+} // minc_set_hugepages
+
+
+// Map the table with a PROT_NONE guard page either side.  The guards stop the kernel merging the table's mapping
+// with its neighbours, so that its huge page coverage can be read back from /proc/self/smaps by its address
+static void *
+map_thp(table_t *table, const size_t len)
+{
+	size_t span = len + HUGE_PAGE_SIZE + (2 * GUARD_SIZE);
+	uint8_t *map, *base, *end;
+
+	if ((map = mmap(NULL, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED) {
+		return NULL;
+	}
+
+	// Trim the alignment slack off both ends, then turn the pages either side of the table into guards
+	base = (uint8_t *)(((uintptr_t)map + GUARD_SIZE + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+	end = base + len + GUARD_SIZE;
+	(base - GUARD_SIZE > map) && munmap(map, (base - GUARD_SIZE) - map);
+	(end < map + span) && munmap(end, (map + span) - end);
+	mprotect(base - GUARD_SIZE, GUARD_SIZE, PROT_NONE);
+	mprotect(base + len, GUARD_SIZE, PROT_NONE);
+
+	(minc_hugepages != MINC_HUGE_OFF) && madvise(base, len, MADV_HUGEPAGE);
+
+	table->map = base - GUARD_SIZE;
+	table->map_len = len + (2 * GUARD_SIZE);
+	table->kind = TABLE_MMAP;
+	return base;
+} // map_thp
+
+
+// Allocate a zeroed table of at least size bytes, with its pages placed on the given node, interleaved over every
+// node, or left to the kernel's default local placement.  Returns NULL if out of memory
+void *
+table_alloc_node(table_t *table, const size_t size, const int node)
+{
+	size_t len = (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+
+	memset(table, 0, sizeof(*table));
+	table->size = size;
+
+	// Memory policies apply to whole pages, so placed tables must be mapped however small they are
+	if ((node == TABLE_NODE_LOCAL) && ((size < HUGE_PAGE_SIZE) || (minc_hugepages == MINC_HUGE_OFF))) {
+		table->kind = TABLE_HEAP;
+		return (table->base = calloc(1, size));
+	}
+
+	if (minc_hugepages == MINC_HUGE_HUGETLB) {
+		void *map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+		if (map != MAP_FAILED) {
+			table->map = map;
+			table->map_len = len;
+			table->kind = TABLE_HUGETLB;
+			table->base = map;
+		}
+	}
+
+	if ((table->base == NULL) && ((table->base = map_thp(table, len)) == NULL)) {
+		return NULL;
+	}
+
+	// Nothing has been touched yet, so the policy decides where every page will be faulted in
+	(node != TABLE_NODE_LOCAL) && node_bind(table->base, len, node);
+	return table->base;
+} // table_alloc_node
+
+
+void *
+table_alloc(table_t *table, const size_t size)
+{
+	return table_alloc_node(table, size, TABLE_NODE_LOCAL);
+} // table_alloc
+
+
+// Read back how much of the table is resident, and how much of that is on huge pages.  This walks smaps up to the
+// table's mapping, which costs more the more mappings there are, so it's only done for queries that asked for
+// stats.  It's read in large chunks, and the lines of other mappings are passed over on their first character
+static void
+table_coverage(const table_t *table, uint64_t *resident, uint64_t *huge)
+{
+	unsigned long start, end, kib;
+	char line[256], buf[65536];
+	int in_table = 0;
+	FILE *fp;
+
+	if ((fp = fopen("/proc/self/smaps", "r")) == NULL) {
+		return;
+	}
+	setvbuf(fp, buf, _IOFBF, sizeof(buf));
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		// Mappings start with their address in lower case hex, and every field of one starts in upper case
+		int header = ((line[0] >= '0') && (line[0] <= '9')) || ((line[0] >= 'a') && (line[0] <= 'f'));
+
+		if (!header && !in_table) {
+			continue;
+		}
+		if (header && (sscanf(line, "%lx-%lx ", &start, &end) == 2)) {
+			if (in_table) {
+				break;
+			}
+			in_table = (start == (uintptr_t)table->base);
+		} else if (in_table) {
+			if (sscanf(line, "Rss: %lu kB", &kib) == 1) {
+				*resident += kib * 1024;
+			} else if ((sscanf(line, "AnonHugePages: %lu kB", &kib) == 1) ||
+				   (sscanf(line, "Private_Hugetlb: %lu kB", &kib) == 1) ||
+				   (sscanf(line, "Shared_Hugetlb: %lu kB", &kib) == 1)) {
+				*huge += kib * 1024;
+				// Hugetlb pages aren't counted in Rss
+				(table->kind == TABLE_HUGETLB) && (*resident += kib * 1024);
+			}
+		}
+	}
+	fclose(fp);
+} // table_coverage
+
+
+// Add what the table holds at the end of this query to its stats.  Pooled tables grow into their size over later
+// queries, and khugepaged may collapse their pages in between, so they're measured afresh every time
+static void
+table_measure(const table_t *table, minc_stats_t *stats)
+{
+	if ((table->kind == TABLE_HEAP) || (table->kind == TABLE_FILE)) {
+		stats->table_bytes += table->size;
+	} else {
+		table_coverage(table, &stats->table_bytes, &stats->huge_bytes);
+	}
+} // table_measure
+
+
+// Release a table.  If stats are wanted, its huge page coverage is measured first, while it's still mapped
+void
+table_free(table_t *table, minc_stats_t *stats)
+{
+	if (table->base == NULL) {
+		return;
+	}
+
+	stats ? table_measure(table, stats) : (void)0;
+	(table->kind == TABLE_HEAP) ? free(table->base) : (void)munmap(table->map, table->map_len);
+	table->base = NULL;
+} // table_free
+
+
+minc_solver_t *
+minc_solver_new(void)
+{
+	minc_solver_t *solver = calloc(1, sizeof(*solver));
+
+	if (solver == NULL) {
+		fprintf(stderr, "Line %d in %s:%s(): Out of memory\n", __LINE__, __FILE__, __func__);
+	}
+	return solver;
+} // minc_solver_new
+
+
+// Release everything allocated from the arena since the last reset, all at once.  Pooled tables are kept
+void
+minc_solver_reset(minc_solver_t *solver)
+{
+	for (arena_chunk_t *chunk = solver->chunks; chunk != NULL; chunk = chunk->next) {
+		chunk->used = 0;
+	}
+	solver->current = solver->chunks;
+} // minc_solver_reset
+
+
+void
+minc_solver_free(minc_solver_t *solver)
+{
+	if (solver == NULL) {
+		return;
+	}
+	for (arena_chunk_t *chunk = solver->chunks, *next; chunk != NULL; chunk = next) {
+		next = chunk->next;
+		free(chunk);
+	}
+	for (uint32_t p = 0; p < solver->n_pooled; p++) {
+		table_free(&solver->pool[p].table, NULL);
+	}
+	free(solver);
+} // minc_solver_free
+
+
+// Bump-allocate from the solver's arena, or just malloc() without a solver.  Returns NULL if out of memory
+void *
+solver_alloc(minc_solver_t *solver, size_t size)
+{
+	arena_chunk_t *chunk, *last = NULL;
+
+	if (solver == NULL) {
+		return malloc(size);
+	}
+
+	size = (size + 15) & ~15UL;
+	for (chunk = solver->current; chunk != NULL; last = chunk, chunk = chunk->next) {
+		if (chunk->size - chunk->used >= size) {
+			break;
+		}
+	}
+
+	if (chunk == NULL) {
+		size_t chunk_size = (size > ARENA_CHUNK) ? size : ARENA_CHUNK;
+
+		if ((chunk = malloc(sizeof(*chunk) + chunk_size)) == NULL) {
+			return NULL;
+		}
+		chunk->next = NULL;
+		chunk->size = chunk_size;
+		chunk->used = 0;
+
+		// The search above ran off the end of the list, so last is the final chunk, if there are any at all
+		(last == NULL) ? (solver->chunks = chunk) : (last->next = chunk);
+	}
+
+	solver->current = chunk;
+	chunk->used += size;
+	return chunk->data + chunk->used - size;
+} // solver_alloc
+
+
+// Get a table of at least size bytes, zeroed if asked for, preferring a pooled one no more than twice the size.
+// Returns NULL if out of memory
+void *
+solver_table_get(minc_solver_t *solver, table_t *table, const size_t size, const int zeroed)
+{
+	uint32_t best = POOL_SLOTS;
+
+	for (uint32_t p = 0; solver && (p < solver->n_pooled); p++) {
+		size_t have = solver->pool[p].table.size;
+
+		if ((have >= size) && (have / 2 <= size) && (!zeroed || solver->pool[p].clean) &&
+		    ((best == POOL_SLOTS) || (have < solver->pool[best].table.size))) {
+			best = p;
+		}
+	}
+
+	if (best == POOL_SLOTS) {
+		return table_alloc(table, size);
+	}
+
+	*table = solver->pool[best].table;
+	solver->pool[best] = solver->pool[--solver->n_pooled];
+	return table->base;
+} // solver_table_get
+
+
+// Give a table back to the solver's pool, or free it without a solver.  A full pool keeps the largest tables,
+// since they are the ones that cost the most to fault in again
+void
+solver_table_put(minc_solver_t *solver, table_t *table, const int clean, minc_stats_t *stats)
+{
+	uint32_t slot, smallest = 0;
+
+	if ((solver == NULL) || (table->base == NULL)) {
+		table_free(table, stats);
+		return;
+	}
+
+	stats ? table_measure(table, stats) : (void)0;
+
+	if (solver->n_pooled < POOL_SLOTS) {
+		slot = solver->n_pooled++;
+	} else {
+		for (uint32_t p = 1; p < POOL_SLOTS; p++) {
+			(solver->pool[p].table.size < solver->pool[smallest].table.size) && (smallest = p);
+		}
+		if (solver->pool[smallest].table.size >= table->size) {
+			table_free(table, NULL);
+			return;
+		}
+		table_free(&solver->pool[smallest].table, NULL);
+		slot = smallest;
+	}
+
+	solver->pool[slot].table = *table;
+	solver->pool[slot].clean = clean;
+	table->base = NULL;
+} // solver_table_put
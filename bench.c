@@ -0,0 +1,815 @@
+// Benchmark suite for the minimum coins search engines
+//
+// Runs every engine against a number of coin-set families, over targets that scale by powers of 10, and reports
+// the time taken, the number of compares, the peak resident memory, and the per-query latency of each combination.
+// All targets and generated coin sets are derived from fixed seeds so that runs are reproducible
+//
+// Author: Stew Forster (stew675@gmail.com)
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "mincoins.h"
+
+#define MAX_FAMILY_COINS	1024
+#define MAX_QUERIES		1024
+#define MAX_REPS		1024
+#define MIN_DELTA_NS		50000.0
+
+typedef struct coin_family {
+	const char	*name;
+	const char	*desc;
+	uint32_t	n_coins;
+	uint32_t	coins[MAX_FAMILY_COINS];
+	uint32_t	max_exp;	// Largest target scale worth running it at, as a power of 10, or 0 for any
+} coin_family_t;
+
+static coin_family_t families[] = {
+	{ "aud",	"Australian currency (canonical)", 8, {1, 2, 5, 10, 20, 50, 100, 200} },
+	{ "usd",	"US currency (canonical)", 6, {1, 5, 10, 25, 50, 100} },
+	{ "adversary",	"{1, k, k+1} with k = 100, defeats greedy", 3, {1, 100, 101} },
+	{ "primes",	"Small primes, no unit coin", 7, {7, 11, 13, 17, 19, 23, 29} },
+	{ "many",	"64 pseudo-random denominations up to 1000", 0, {0} },
+	{ "biggcd",	"Large common divisor of 500", 4, {1000, 1500, 3500, 5500} },
+	{ "tokens",	"1000 pseudo-random denominations up to 20000", 0, {0}, 5 },
+};
+static const uint32_t n_families = sizeof(families) / sizeof(*families);
+
+// One benchmark result, as printed, written to the JSON results and compared against a baseline
+typedef struct bench_row {
+	char		engine[16];
+	char		family[16];
+	uint64_t	target;
+	uint32_t	reps;
+	uint32_t	queries;
+	uint64_t	median_ns;	// Median time of a repetition of all queries
+	uint64_t	mad_ns;		// Median absolute deviation of the repetition times
+	uint64_t	mean_lat_ns;
+	uint64_t	p99_lat_ns;
+	uint64_t	compares;	// Total over one pass of all queries
+	uint64_t	peak_kib;
+} bench_row_t;
+
+static struct {
+	const char	*engine;
+	const char	*family;
+	uint32_t	min_exp;
+	uint32_t	max_exp;
+	uint32_t	warmup;
+	uint32_t	reps;
+	uint32_t	queries;
+	minc_perf_t	*perf;
+	const char	*output;	// Where to write the JSON results
+	const char	*baseline;	// JSON results to compare against
+	double		threshold;	// Smallest slowdown, as a fraction, that's reported as a regression
+	int		sweep;		// Run a scaling study instead of the suite
+	uint64_t	sweep_lo;
+	uint64_t	sweep_hi;
+	double		sweep_factor;
+} opts = { NULL, NULL, 2, 7, 1, 5, 8, NULL, NULL, NULL, 0.10, 0, 100, 100000000, 2.0 };
+
+// A coin set given with -C, which replaces the built-in families
+static coin_family_t custom_family = { "custom", "Coin set given on the command line", 0, {0} };
+
+// Workloads loaded with -W, such as those written by minc_gen, which also replace the built-in families.  Each is
+// one case, with the targets to query given explicitly rather than spread over a power of 10
+typedef struct workload {
+	coin_family_t	fam;
+	uint64_t	scale;
+	uint32_t	n_targets;
+	uint32_t	targets[MAX_QUERIES];
+} workload_t;
+
+static workload_t *workloads = NULL;
+static uint32_t n_workloads = 0;
+
+static bench_row_t *rows = NULL;
+static uint32_t n_rows = 0, max_rows = 0;
+
+// Shared by every case, so that tables are recycled between queries as they would be in a long running process
+static minc_solver_t *solver = NULL;
+
+
+// Simple LCG so that generated data is identical across platforms and C libraries
+static uint32_t
+bench_rand(uint64_t *state)
+{
+	*state = (*state * 6364136223846793005ULL) + 1442695040888963407ULL;
+	return (uint32_t)(*state >> 33);
+} // bench_rand
+
+
+// Fill in a generated family with a unit coin and n_coins - 1 distinct denominations in the range 2..max_coin
+static void
+generate_family(coin_family_t *fam, const uint32_t n_coins, const uint32_t max_coin)
+{
+	uint64_t seed = 0x6d696e63;
+
+	fam->coins[0] = 1;
+	fam->n_coins = 1;
+	while (fam->n_coins < n_coins) {
+		uint32_t coin = 2 + (bench_rand(&seed) % (max_coin - 1)), c;
+
+		for (c = 0; (c < fam->n_coins) && (fam->coins[c] != coin); c++);
+		if (c == fam->n_coins) {
+			fam->coins[fam->n_coins++] = coin;
+		}
+	}
+} // generate_family
+
+
+// Resets the kernel's peak RSS tracking for this process.  Returns 0 if that isn't supported
+static int
+reset_peak_rss(void)
+{
+	FILE *fp = fopen("/proc/self/clear_refs", "w");
+	int ok;
+
+	if (fp == NULL) {
+		return 0;
+	}
+	ok = (fputs("5", fp) >= 0);
+	return (fclose(fp) == 0) && ok;
+} // reset_peak_rss
+
+
+// Returns the peak RSS in KiB since the last reset, falling back to the lifetime peak of the process
+static uint64_t
+get_peak_rss(void)
+{
+	FILE *fp = fopen("/proc/self/status", "r");
+	uint64_t kb = 0;
+	char line[256];
+
+	if (fp != NULL) {
+		while (fgets(line, sizeof(line), fp) != NULL) {
+			if (sscanf(line, "VmHWM: %lu kB", &kb) == 1) {
+				break;
+			}
+		}
+		fclose(fp);
+	}
+
+	if (kb == 0) {
+		struct rusage ru;
+
+		getrusage(RUSAGE_SELF, &ru);
+		kb = ru.ru_maxrss;
+	}
+	return kb;
+} // get_peak_rss
+
+
+static int
+u64_cmp(const void *a, const void *b)
+{
+	uint64_t va = *(const uint64_t *)a, vb = *(const uint64_t *)b;
+
+	return (va > vb) - (va < vb);
+} // u64_cmp
+
+
+// Run every query once, recording latencies, and statistics if wanted.  Returns -1 if the engine failed to run
+static int
+run_queries(const minc_engine_t *eng, const coin_family_t *fam, const uint32_t targets[], uint32_t n_targets,
+	    minc_hist_t *hist, minc_stats_t *stats)
+{
+	uint32_t coins[MAX_FAMILY_COINS];
+	minc_result_t result;
+
+	for (uint32_t q = 0; q < n_targets; q++) {
+		memcpy(coins, fam->coins, fam->n_coins * sizeof(*coins));
+
+		uint64_t start = minc_now_ns();
+		int ret = eng->solve(solver, coins, fam->n_coins, targets[q], &result, stats);
+		uint64_t lat = minc_now_ns() - start;
+
+		if (ret < 0) {
+			return -1;
+		}
+		minc_free_result(&result);
+		minc_solver_reset(solver);
+		minc_hist_record(hist, lat);
+	}
+	return 0;
+} // run_queries
+
+
+static bench_row_t *
+new_row(void)
+{
+	if (n_rows == max_rows) {
+		max_rows = max_rows ? (max_rows * 2) : 64;
+		if ((rows = realloc(rows, max_rows * sizeof(*rows))) == NULL) {
+			fprintf(stderr, "Line %d in %s:%s(): Out of memory\n", __LINE__, __FILE__, __func__);
+			exit(1);
+		}
+	}
+	memset(&rows[n_rows], 0, sizeof(*rows));
+	return &rows[n_rows++];
+} // new_row
+
+
+// Benchmark one engine on one coin set.  If given[] is NULL, opts.queries targets are spread over the scale
+static void
+bench_case(const minc_engine_t *eng, const coin_family_t *fam, uint64_t scale, const uint32_t given[],
+	   uint32_t n_queries)
+{
+	static minc_hist_t hist, scratch;
+	minc_stats_t stats = { .perf = opts.perf };
+	uint64_t rep_ns[MAX_REPS], dev_ns[MAX_REPS];
+	uint32_t targets[MAX_QUERIES];
+	bench_row_t *row;
+
+	if (given != NULL) {
+		memcpy(targets, given, n_queries * sizeof(*targets));
+	} else {
+		// Spread the queries over the top 10% of the scale so each one exercises a distinct table size
+		n_queries = opts.queries;
+		for (uint32_t q = 0; q < n_queries; q++) {
+			targets[q] = scale - ((q * 7919ULL) % ((scale / 10) + 1));
+		}
+	}
+
+	// Statistics are gathered on an untimed pass so that the timed repetitions run at full speed
+	for (uint32_t w = 0; w <= opts.warmup; w++) {
+		if (run_queries(eng, fam, targets, n_queries, &scratch, (w == 0) ? &stats : NULL) < 0) {
+			goto failed;
+		}
+	}
+
+	reset_peak_rss();
+	minc_hist_init(&hist);
+
+	for (uint32_t r = 0; r < opts.reps; r++) {
+		uint64_t start = minc_now_ns();
+
+		if (run_queries(eng, fam, targets, n_queries, &hist, NULL) < 0) {
+			goto failed;
+		}
+		rep_ns[r] = minc_now_ns() - start;
+	}
+
+	qsort(rep_ns, opts.reps, sizeof(*rep_ns), u64_cmp);
+
+	row = new_row();
+	snprintf(row->engine, sizeof(row->engine), "%s", eng->name);
+	snprintf(row->family, sizeof(row->family), "%s", fam->name);
+	row->target = scale;
+	row->reps = opts.reps;
+	row->queries = n_queries;
+	row->median_ns = rep_ns[opts.reps / 2];
+	for (uint32_t r = 0; r < opts.reps; r++) {
+		dev_ns[r] = (rep_ns[r] > row->median_ns) ? (rep_ns[r] - row->median_ns) : (row->median_ns - rep_ns[r]);
+	}
+	qsort(dev_ns, opts.reps, sizeof(*dev_ns), u64_cmp);
+	row->mad_ns = dev_ns[opts.reps / 2];
+	row->mean_lat_ns = hist.sum / hist.count;
+	row->p99_lat_ns = minc_hist_percentile(&hist, 99.0);
+	row->compares = stats.compares;
+	row->peak_kib = get_peak_rss();
+
+	printf("%-8s %-10s %12lu %12.3f %12.3f %12.3f %12.3f %12.3f %14.1f %10lu %6.1f\n", eng->name, fam->name,
+	       (unsigned long)scale, row->median_ns / 1e6, row->mean_lat_ns / 1e3,
+	       minc_hist_percentile(&hist, 50.0) / 1e3, row->p99_lat_ns / 1e3, hist.max / 1e3,
+	       stats.compares / (double)n_queries, (unsigned long)row->peak_kib,
+	       stats.table_bytes ? (100.0 * stats.huge_bytes / stats.table_bytes) : 0.0);
+	if (opts.perf) {
+		minc_print_perf(&stats, "    ");
+	}
+	fflush(stdout);
+	return;
+
+failed:
+	printf("%-8s %-10s %12lu   engine %s\n", eng->name, fam->name, (unsigned long)scale,
+	       (eng->declines && eng->declines(fam->coins, fam->n_coins)) ? "declines the coin set" : "failed to run");
+	fflush(stdout);
+} // bench_case
+
+
+// Results are written one per line, in a fixed layout, so that read_results() can parse them back without
+// needing a general JSON parser
+static int
+write_results(const char *path)
+{
+	FILE *fp = fopen(path, "w");
+
+	if (fp == NULL) {
+		perror(path);
+		return -1;
+	}
+
+	fprintf(fp, "{\"minc_bench\": 1, \"results\": [\n");
+	for (uint32_t i = 0; i < n_rows; i++) {
+		const bench_row_t *r = &rows[i];
+
+		fprintf(fp, "{\"engine\":\"%s\",\"family\":\"%s\",\"target\":%lu,\"reps\":%u,\"queries\":%u,"
+			"\"median_ns\":%lu,\"mad_ns\":%lu,\"mean_lat_ns\":%lu,\"p99_lat_ns\":%lu,\"compares\":%lu,"
+			"\"peak_kib\":%lu}%s\n", r->engine, r->family, (unsigned long)r->target, r->reps, r->queries,
+			(unsigned long)r->median_ns, (unsigned long)r->mad_ns, (unsigned long)r->mean_lat_ns,
+			(unsigned long)r->p99_lat_ns, (unsigned long)r->compares, (unsigned long)r->peak_kib,
+			(i + 1 < n_rows) ? "," : "");
+	}
+	fprintf(fp, "]}\n");
+
+	return (fclose(fp) == 0) ? 0 : -1;
+} // write_results
+
+
+// Read back results written by write_results().  Returns the number of results read, or -1 on error
+static int
+read_results(const char *path, bench_row_t **out)
+{
+	FILE *fp = fopen(path, "r");
+	bench_row_t *res = NULL, r;
+	uint32_t n = 0, max = 0;
+	unsigned long v[8];
+	char line[1024];
+
+	if (fp == NULL) {
+		perror(path);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		memset(&r, 0, sizeof(r));
+		if (sscanf(line, " {\"engine\":\"%15[^\"]\",\"family\":\"%15[^\"]\",\"target\":%lu,\"reps\":%u,"
+			   "\"queries\":%u,\"median_ns\":%lu,\"mad_ns\":%lu,\"mean_lat_ns\":%lu,\"p99_lat_ns\":%lu,"
+			   "\"compares\":%lu,\"peak_kib\":%lu}", r.engine, r.family, &v[0], &r.reps, &r.queries, &v[1],
+			   &v[2], &v[3], &v[4], &v[5], &v[6]) != 11) {
+			continue;
+		}
+		r.target = v[0];
+		r.median_ns = v[1];
+		r.mad_ns = v[2];
+		r.mean_lat_ns = v[3];
+		r.p99_lat_ns = v[4];
+		r.compares = v[5];
+		r.peak_kib = v[6];
+
+		if (n == max) {
+			max = max ? (max * 2) : 64;
+			if ((res = realloc(res, max * sizeof(*res))) == NULL) {
+				fprintf(stderr, "Line %d in %s:%s(): Out of memory\n", __LINE__, __FILE__, __func__);
+				fclose(fp);
+				return -1;
+			}
+		}
+		res[n++] = r;
+	}
+	fclose(fp);
+
+	*out = res;
+	return n;
+} // read_results
+
+
+// Compare this run against a baseline.  A case is only called slower if its median moved by more than all of the
+// relative threshold, three standard deviations of repetition noise (estimated from the larger of the two MADs), and
+// MIN_DELTA_NS, below which run-to-run cache and frequency effects swamp any real change.
+// Compare counts are deterministic, so any increase in them is reported regardless of noise.  Returns the number of
+// regressions found
+static int
+compare_results(const char *path)
+{
+	uint32_t eng_regress[64] = {0}, fam_regress[64] = {0};
+	bench_row_t *base = NULL;
+	int n_base, regressions = 0;
+
+	if ((n_base = read_results(path, &base)) < 0) {
+		return -1;
+	}
+
+	printf("\nComparison against %s (%d baseline results, threshold %.0f%%)\n", path, n_base, opts.threshold * 100);
+
+	for (uint32_t i = 0; i < n_rows; i++) {
+		const bench_row_t *cur = &rows[i], *old = NULL;
+
+		for (int b = 0; (b < n_base) && (old == NULL); b++) {
+			if (!strcmp(base[b].engine, cur->engine) && !strcmp(base[b].family, cur->family) &&
+			    (base[b].target == cur->target)) {
+				old = &base[b];
+			}
+		}
+		if (old == NULL) {
+			printf("  %-8s %-10s %12lu  new, no baseline\n", cur->engine, cur->family, (unsigned long)cur->target);
+			continue;
+		}
+
+		double noise = 3.0 * 1.4826 * (double)((old->mad_ns > cur->mad_ns) ? old->mad_ns : cur->mad_ns);
+		double allowed = opts.threshold * old->median_ns;
+		double delta = (double)cur->median_ns - (double)old->median_ns;
+		double old_cmp = old->compares / (double)(old->queries ? old->queries : 1);
+		double cur_cmp = cur->compares / (double)cur->queries;
+		int slower = 0;
+
+		(noise > allowed) && (allowed = noise);
+		(MIN_DELTA_NS > allowed) && (allowed = MIN_DELTA_NS);
+
+		if (delta > allowed) {
+			printf("  %-8s %-10s %12lu  SLOWER  %+.1f%% (%.3f -> %.3f ms)\n", cur->engine, cur->family,
+			       (unsigned long)cur->target, 100.0 * delta / old->median_ns, old->median_ns / 1e6,
+			       cur->median_ns / 1e6);
+			slower = 1;
+		} else if (-delta > allowed) {
+			printf("  %-8s %-10s %12lu  faster  %+.1f%% (%.3f -> %.3f ms)\n", cur->engine, cur->family,
+			       (unsigned long)cur->target, 100.0 * delta / old->median_ns, old->median_ns / 1e6,
+			       cur->median_ns / 1e6);
+		}
+		if (cur_cmp > old_cmp * 1.001) {
+			printf("  %-8s %-10s %12lu  MORE COMPARES  %.1f -> %.1f per query\n", cur->engine, cur->family,
+			       (unsigned long)cur->target, old_cmp, cur_cmp);
+			slower = 1;
+		}
+
+		if (slower) {
+			regressions++;
+			for (uint32_t e = 0; (e < minc_n_engines) && (e < 64); e++) {
+				!strcmp(minc_engines[e].name, cur->engine) && eng_regress[e]++;
+			}
+			for (uint32_t f = 0; (f < n_families) && (f < 64); f++) {
+				!strcmp(families[f].name, cur->family) && fam_regress[f]++;
+			}
+		}
+	}
+
+	if (regressions == 0) {
+		printf("  No regressions\n");
+	} else {
+		printf("\n%d regression%s.  By engine:", regressions, (regressions == 1) ? "" : "s");
+		for (uint32_t e = 0; (e < minc_n_engines) && (e < 64); e++) {
+			eng_regress[e] && printf(" %s(%u)", minc_engines[e].name, eng_regress[e]);
+		}
+		printf("  By family:");
+		for (uint32_t f = 0; (f < n_families) && (f < 64); f++) {
+			fam_regress[f] && printf(" %s(%u)", families[f].name, fam_regress[f]);
+		}
+		printf("\n");
+	}
+
+	free(base);
+	return regressions;
+} // compare_results
+
+
+// Family f of the built-in families, or the custom family after them, if it was selected to run
+static coin_family_t *
+selected_family(const uint32_t f)
+{
+	coin_family_t *fam = (f < n_families) ? &families[f] : &custom_family;
+
+	if ((fam->n_coins == 0) || ((opts.family != NULL) && strcmp(opts.family, fam->name))) {
+		return NULL;
+	}
+	return fam;
+} // selected_family
+
+
+// Parse a comma separated list of values.  Returns the number parsed, or -1 if the list is malformed
+static int
+parse_list(const char *str, uint32_t vals[], const uint32_t max_vals)
+{
+	uint32_t n = 0;
+	char *end;
+
+	while (*str != '\0') {
+		unsigned long val = strtoul(str, &end, 10);
+
+		if ((end == str) || (val == 0) || (val >= UINT32_MAX) || (n == max_vals)) {
+			return -1;
+		}
+		if ((*end != ',') && (*end != '\0')) {
+			return -1;
+		}
+		vals[n++] = val;
+		str = (*end == ',') ? (end + 1) : end;
+	}
+	return n;
+} // parse_list
+
+
+static int
+parse_coins(const char *str, coin_family_t *fam)
+{
+	int n = parse_list(str, fam->coins, MAX_FAMILY_COINS);
+
+	fam->n_coins = (n > 0) ? n : 0;
+	return (n > 0) ? 0 : -1;
+} // parse_coins
+
+
+// Load workloads, one per line, as:  name scale coin,coin,...  target,target,...
+// Blank lines and lines starting with '#' are ignored.  Returns -1 on any malformed line
+static int
+load_workloads(const char *path)
+{
+	FILE *fp = fopen(path, "r");
+	char line[16384], name[16], coins[1024], targets[16000];
+	unsigned long long scale;
+	uint32_t max = 0;
+
+	if (fp == NULL) {
+		perror(path);
+		return -1;
+	}
+
+	for (uint32_t lineno = 1; fgets(line, sizeof(line), fp) != NULL; lineno++) {
+		workload_t *wl;
+		int n;
+
+		if ((line[0] == '#') || (strspn(line, " \t\r\n") == strlen(line))) {
+			continue;
+		}
+
+		if (n_workloads == max) {
+			max = max ? (max * 2) : 32;
+			if ((workloads = realloc(workloads, max * sizeof(*workloads))) == NULL) {
+				fprintf(stderr, "Line %d in %s:%s(): Out of memory\n", __LINE__, __FILE__, __func__);
+				fclose(fp);
+				return -1;
+			}
+		}
+		wl = &workloads[n_workloads];
+		memset(wl, 0, sizeof(*wl));
+
+		if ((sscanf(line, "%15s %llu %1023s %15999s", name, &scale, coins, targets) != 4) ||
+		    (parse_coins(coins, &wl->fam) < 0) || ((n = parse_list(targets, wl->targets, MAX_QUERIES)) < 1)) {
+			fprintf(stderr, "Error: %s line %u is not a valid workload\n", path, lineno);
+			fclose(fp);
+			return -1;
+		}
+		wl->fam.name = strdup(name);
+		wl->fam.desc = "Loaded from a workload file";
+		wl->scale = scale;
+		wl->n_targets = n;
+		n_workloads++;
+	}
+
+	fclose(fp);
+	return 0;
+} // load_workloads
+
+
+// Scaling study: sweep the target geometrically for one coin set and engine, emitting a CSV row per point.  Each
+// point is run reps times with statistics enabled and the median of each timing is reported, where build time is
+// everything up to the end of the search, and answer time is recovering the coins from the finished table
+static void
+sweep_case(const minc_engine_t *eng, const coin_family_t *fam)
+{
+	uint64_t build_ns[MAX_REPS], answer_ns[MAX_REPS], total_ns[MAX_REPS];
+	uint32_t coins[MAX_FAMILY_COINS];
+	minc_result_t result;
+
+	for (double t = opts.sweep_lo, last = 0; t <= (double)opts.sweep_hi; t *= opts.sweep_factor) {
+		uint64_t target = (uint64_t)(t + 0.5), minflt = 0, majflt = 0, peak_kib = 0;
+		minc_stats_t stats;
+		uint32_t nr = 0;
+
+		if ((target <= last) || (target >= UINT32_MAX)) {
+			continue;
+		}
+		last = target;
+
+		for (uint32_t r = 0; r < opts.reps; r++) {
+			struct rusage before, after;
+			uint64_t start;
+			int ret;
+
+			memset(&stats, 0, sizeof(stats));
+			memcpy(coins, fam->coins, fam->n_coins * sizeof(*coins));
+			reset_peak_rss();
+			getrusage(RUSAGE_SELF, &before);
+
+			start = minc_now_ns();
+			ret = eng->solve(NULL, coins, fam->n_coins, target, &result, &stats);
+			total_ns[r] = minc_now_ns() - start;
+
+			getrusage(RUSAGE_SELF, &after);
+			if (ret < 0) {
+				printf("%s,%s,%lu,,,,,,,,,failed\n", eng->name, fam->name, (unsigned long)target);
+				fflush(stdout);
+				return;
+			}
+			nr = result.nr;
+			minc_free_result(&result);
+
+			build_ns[r] = stats.phase_ns[MINC_PHASE_SORT] + stats.phase_ns[MINC_PHASE_LCM] +
+				      stats.phase_ns[MINC_PHASE_SEARCH];
+			answer_ns[r] = stats.phase_ns[MINC_PHASE_RECONSTRUCT];
+
+			// Faults and memory vary a little with what the allocator already holds, so keep the worst
+			(after.ru_minflt - before.ru_minflt > minflt) && (minflt = after.ru_minflt - before.ru_minflt);
+			(after.ru_majflt - before.ru_majflt > majflt) && (majflt = after.ru_majflt - before.ru_majflt);
+			(get_peak_rss() > peak_kib) && (peak_kib = get_peak_rss());
+		}
+
+		qsort(build_ns, opts.reps, sizeof(*build_ns), u64_cmp);
+		qsort(answer_ns, opts.reps, sizeof(*answer_ns), u64_cmp);
+		qsort(total_ns, opts.reps, sizeof(*total_ns), u64_cmp);
+
+		printf("%s,%s,%lu,%.3f,%.3f,%.3f,%lu,%lu,%lu,%lu,%lu,%u\n", eng->name, fam->name, (unsigned long)target,
+		       build_ns[opts.reps / 2] / 1e6, answer_ns[opts.reps / 2] / 1e3, total_ns[opts.reps / 2] / 1e6,
+		       (unsigned long)peak_kib, (unsigned long)minflt, (unsigned long)majflt,
+		       (unsigned long)stats.compares, (unsigned long)stats.leap, nr);
+		fflush(stdout);
+	}
+} // sweep_case
+
+
+static void
+usage(const char *prog)
+{
+	printf("Usage: %s [-e engine] [-f family] [-n min_exp] [-m max_exp] [-w warmup] [-r reps] [-q queries] [-p]\n"
+	       "       [-g mode] [-j threads] [-o results.json] [-c baseline.json] [-t threshold%%]\n"
+	       "       [-C coins | -W workloads]\n", prog);
+	printf("       %s -S [-e engine] [-f family | -C coins] [-L lo] [-H hi] [-x factor] [-r reps]\n\n", prog);
+	printf("  -e engine   Only run the named engine (default: all)\n");
+	printf("  -f family   Only run the named coin-set family (default: all)\n");
+	printf("  -n min_exp  Smallest target scale as a power of 10 (default: %u)\n", opts.min_exp);
+	printf("  -m max_exp  Largest target scale as a power of 10 (default: %u)\n", opts.max_exp);
+	printf("  -w warmup   Untimed warmup passes per case, after the statistics pass (default: %u)\n", opts.warmup);
+	printf("  -r reps     Timed repetitions per case (default: %u)\n", opts.reps);
+	printf("  -q queries  Targets queried per repetition (default: %u)\n", opts.queries);
+	printf("  -p          Count hardware performance events per phase on the statistics pass\n");
+	printf("  -g mode     Back large search tables with huge pages: off, thp (default) or hugetlb\n");
+	printf("  -j threads  Threads the wavefront engine may use for one query, at most one per 4096 of the smallest\n");
+	printf("              coin (default: one per CPU)\n");
+	printf("  -o file     Write the results as JSON\n");
+	printf("  -c file     Compare against JSON results from an earlier run, and exit non-zero on regressions\n");
+	printf("  -t percent  Smallest slowdown that counts as a regression (default: %.0f)\n", opts.threshold * 100);
+	printf("  -C coins    Use this comma separated coin set instead of the built-in families\n");
+	printf("  -W file     Run the workloads in this file, as written by minc_gen, instead of the built-in families\n\n");
+
+	printf("Scaling study, emitting CSV:\n");
+	printf("  -S          Sweep the target geometrically for each selected engine and coin set\n");
+	printf("  -L lo       Smallest target of the sweep (default: %lu)\n", (unsigned long)opts.sweep_lo);
+	printf("  -H hi       Largest target of the sweep (default: %lu)\n", (unsigned long)opts.sweep_hi);
+	printf("  -x factor   Growth factor between sweep points (default: %.1f)\n\n", opts.sweep_factor);
+
+	printf("Engines:\n");
+	for (uint32_t e = 0; e < minc_n_engines; e++) {
+		printf("  %-10s %s\n", minc_engines[e].name, minc_engines[e].desc);
+	}
+	printf("\nFamilies:\n");
+	for (uint32_t f = 0; f < n_families; f++) {
+		printf("  %-10s %s\n", families[f].name, families[f].desc);
+	}
+} // usage
+
+
+int
+main(int argc, char *argv[])
+{
+	int opt, perf = 0, ret = 0;
+
+	generate_family(&families[4], 64, 1000);
+	generate_family(&families[6], 1000, 20000);
+
+	// Pin the mmap threshold so glibc doesn't start serving large tables from the heap after the first free,
+	// which would leave them resident and make every later peak RSS reading meaningless
+	mallopt(M_MMAP_THRESHOLD, 128 * 1024);
+
+	if ((solver = minc_solver_new()) == NULL) {
+		return 1;
+	}
+
+	while ((opt = getopt(argc, argv, "e:f:n:m:w:r:q:pg:j:o:c:t:C:W:SL:H:x:h")) != -1) {
+		switch (opt) {
+		case 'e': opts.engine = optarg; break;
+		case 'f': opts.family = optarg; break;
+		case 'n': opts.min_exp = atoi(optarg); break;
+		case 'm': opts.max_exp = atoi(optarg); break;
+		case 'w': opts.warmup = atoi(optarg); break;
+		case 'r': opts.reps = atoi(optarg); break;
+		case 'q': opts.queries = atoi(optarg); break;
+		case 'p': perf = 1; break;
+		case 'g':
+			if (minc_set_hugepages(optarg) < 0) {
+				fprintf(stderr, "Error: unknown huge page mode '%s'\n", optarg);
+				return 1;
+			}
+			break;
+		case 'j': minc_dp_threads = strtoul(optarg, NULL, 10); break;
+		case 'o': opts.output = optarg; break;
+		case 'c': opts.baseline = optarg; break;
+		case 't': opts.threshold = atof(optarg) / 100.0; break;
+		case 'S': opts.sweep = 1; break;
+		case 'L': opts.sweep_lo = strtoull(optarg, NULL, 10); break;
+		case 'H': opts.sweep_hi = strtoull(optarg, NULL, 10); break;
+		case 'x': opts.sweep_factor = atof(optarg); break;
+		case 'C':
+			if (parse_coins(optarg, &custom_family) < 0) {
+				fprintf(stderr, "Error: coins must be a comma separated list of up to %d positive values\n",
+					MAX_FAMILY_COINS);
+				return 1;
+			}
+			opts.family = custom_family.name;
+			break;
+		case 'W':
+			if (load_workloads(optarg) < 0) {
+				return 1;
+			}
+			break;
+		default:
+			usage(argv[0]);
+			return (opt == 'h') ? 0 : 1;
+		}
+	}
+
+	if ((opts.reps < 1) || (opts.reps > MAX_REPS) || (opts.queries < 1) || (opts.queries > MAX_QUERIES)) {
+		fprintf(stderr, "Error: reps must be 1..%d and queries must be 1..%d\n", MAX_REPS, MAX_QUERIES);
+		return 1;
+	}
+
+	if ((opts.engine != NULL) && (minc_find_engine(opts.engine) == NULL)) {
+		fprintf(stderr, "Error: unknown engine '%s'\n", opts.engine);
+		return 1;
+	}
+
+	if (opts.sweep) {
+		if (n_workloads > 0) {
+			fprintf(stderr, "Error: workloads have their own targets, so can't be swept.  Use -C instead\n");
+			return 1;
+		}
+		if ((opts.sweep_lo < 1) || (opts.sweep_factor <= 1.0)) {
+			fprintf(stderr, "Error: the sweep needs a lowest target of at least 1, and a factor above 1\n");
+			return 1;
+		}
+		printf("engine,coins,target,build_ms,answer_us,latency_ms,peak_kib,minor_faults,major_faults,"
+		       "compares,leap,nr\n");
+		for (uint32_t e = 0; e < minc_n_engines; e++) {
+			if ((opts.engine != NULL) && strcmp(opts.engine, minc_engines[e].name)) {
+				continue;
+			}
+			for (uint32_t f = 0; f <= n_families; f++) {
+				if (selected_family(f) != NULL) {
+					sweep_case(&minc_engines[e], selected_family(f));
+				}
+			}
+		}
+		return 0;
+	}
+
+	if (perf && ((opts.perf = minc_perf_open()) == NULL)) {
+		fprintf(stderr, "Warning: hardware performance counters are unavailable\n");
+	}
+
+	printf("%-8s %-10s %12s %12s %12s %12s %12s %12s %14s %10s %6s\n", "engine", "family", "target",
+	       "median(ms)", "q-mean(us)", "q-p50(us)", "q-p99(us)", "q-max(us)", "compares/q", "peak(KiB)", "huge%");
+
+	for (uint32_t e = 0; e < minc_n_engines; e++) {
+		if ((opts.engine != NULL) && strcmp(opts.engine, minc_engines[e].name)) {
+			continue;
+		}
+		for (uint32_t w = 0; w < n_workloads; w++) {
+			if ((opts.family == NULL) || !strcmp(opts.family, workloads[w].fam.name)) {
+				bench_case(&minc_engines[e], &workloads[w].fam, workloads[w].scale, workloads[w].targets,
+					   workloads[w].n_targets);
+			}
+		}
+		for (uint32_t f = 0; (n_workloads == 0) && (f <= n_families); f++) {
+			coin_family_t *fam = selected_family(f);
+
+			if (fam == NULL) {
+				continue;
+			}
+
+			uint64_t scale = 1;
+
+			for (uint32_t x = 0; x < opts.min_exp; x++, scale *= 10);
+			for (uint32_t x = opts.min_exp; x <= opts.max_exp; x++, scale *= 10) {
+				if (scale >= UINT32_MAX) {
+					printf("%-8s %-10s %12lu   skipped, targets are limited to 32 bits\n",
+					       minc_engines[e].name, fam->name, (unsigned long)scale);
+					continue;
+				}
+				if (fam->max_exp && (x > fam->max_exp)) {
+					printf("%-8s %-10s %12lu   skipped, beyond the family's largest scale\n",
+					       minc_engines[e].name, fam->name, (unsigned long)scale);
+					continue;
+				}
+				bench_case(&minc_engines[e], fam, scale, NULL, 0);
+			}
+		}
+	}
+
+	if ((opts.output != NULL) && (write_results(opts.output) < 0)) {
+		ret = 1;
+	}
+	if ((opts.baseline != NULL) && (compare_results(opts.baseline) != 0)) {
+		ret = 1;
+	}
+
+	minc_perf_close(opts.perf);
+	for (uint32_t w = 0; w < n_workloads; w++) {
+		free((char *)workloads[w].fam.name);
+	}
+	free(workloads);
+	free(rows);
+	return ret;
+} // main
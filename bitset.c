@@ -0,0 +1,258 @@
+// Bitset engine for large denomination sets
+//
+// The breadth-first search tests every coin against every total it dequeues, which is O(N * T) however many of
+// those totals were already reached.  With hundreds or thousands of coins that dominates everything.  This engine
+// searches level by level instead, and can build the next level as the frontier shifted by every coin, 64 totals
+// to a word.  Each level is built in whichever of three ways is cheapest:
+//
+//   by coin:	OR the frontier's window into the next level once per coin, costing N * frontier words
+//   by total:	OR the bitset of coins into the next level once per frontier total, costing count * coin words
+//   by pair:	Try every coin on every frontier total, costing count * N, as the breadth-first search does
+//
+// The second doesn't depend on N at all, so on large dense coin sets, whose frontiers are narrow bands, the cost
+// grows far slower than the number of coins.  The third keeps a few coins with a sparse, scattered frontier from
+// paying for all of the empty words in between.  Only the level each total was first reached at is recorded, and the
+// breakdown is recovered by stepping back along any coin that leads one level down
+//
+// Author: Stew Forster (stew675@gmail.com)
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mincoins_int.h"
+
+#define WORD_BITS	64
+
+
+static inline int
+bit_test(const uint64_t *bits, const uint64_t pos)
+{
+	return (bits[pos / WORD_BITS] >> (pos % WORD_BITS)) & 1;
+} // bit_test
+
+
+// OR the words lo..hi of src, shifted up by shift bits, into dst, dropping anything beyond word max.  The words
+// either side of src's range must be zero.  Shifting the carry by 1 and then by 63 - r avoids an undefined shift
+// by 64 when r is 0, and keeps the loop branch free so that it vectorises
+static inline void
+shift_or(uint64_t *restrict dst, const uint64_t *restrict src, const uint64_t lo, const uint64_t hi,
+	 const uint64_t shift, const uint64_t max)
+{
+	uint64_t q = shift / WORD_BITS, r = shift % WORD_BITS;
+	uint64_t end = ((hi + q + 1) < max) ? (hi + q + 1) : max;
+
+	for (uint64_t d = lo + q; d <= end; d++) {
+		dst[d] |= (src[d - q] << r) | ((src[d - q - 1] >> 1) >> (63 - r));
+	}
+} // shift_or
+
+
+// Note a total reached for the first time at level k, in the queue and in the span of the new frontier
+static inline void
+bitset_reach(const uint64_t total, const uint32_t k, uint32_t *level, uint32_t *queue, uint64_t *q_end,
+	     uint64_t *lo, uint64_t *hi)
+{
+	level[total] = k;
+	queue[(*q_end)++] = total;
+	(total < *lo) && (*lo = total);
+	(total > *hi) && (*hi = total);
+} // bitset_reach
+
+
+// Search out levels from zero until span is reached or no new totals turn up.  Each total reached has its bit set
+// in seen[], the level it was reached at written to level[], and is added to queue[], so that a level is a run of
+// the queue.  frontier[] and next[] each have a spare word either side of span's words, and coin_bits[] has the
+// coins set, with a spare zero word either side too.  Returns the number of coins needed to make span, or 0 if it
+// can't be made
+static uint32_t
+bitset_search(const uint32_t coins[], const uint32_t n_coins, const uint32_t span, uint32_t *level, uint32_t *queue,
+	      uint64_t *seen, uint64_t *frontier, uint64_t *next, const uint64_t *coin_bits, minc_stats_t *stats)
+{
+	uint64_t w_max = span / WORD_BITS, coin_words = coins[n_coins - 1] / WORD_BITS + 1;
+	uint64_t lo = 0, hi = 0, q_start = 0, q_end = 1, compares = 0;
+	uint32_t k;
+
+	queue[0] = 0;
+	seen[0] |= 1;
+	level[0] = 0;
+
+	for (k = 0; (q_start < q_end) && !bit_test(seen, span); k++) {
+		uint64_t count = q_end - q_start, flo = lo / WORD_BITS, fhi = hi / WORD_BITS;
+		uint64_t nlo = lo + coins[0], nhi = (uint64_t)hi + coins[n_coins - 1], level_end = q_end;
+
+		if (nlo > span) {
+			break;
+		}
+		(nhi > span) && (nhi = span);
+
+		// Shifting also costs a pass to lay the frontier out as a bitset, and another to pick out what's new
+		uint64_t fw = fhi - flo + 1, nw = (nhi / WORD_BITS) - (nlo / WORD_BITS) + 1;
+		uint64_t by_pair = count * n_coins, by_coin = ((uint64_t)n_coins * fw) + fw + nw;
+		uint64_t by_total = (count * coin_words) + fw + nw;
+
+		lo = UINT64_MAX;
+		hi = 0;
+
+		if ((by_pair <= by_coin) && (by_pair <= by_total)) {
+			for (uint64_t q = q_start; q < level_end; q++) {
+				for (uint32_t c = 0; (c < n_coins) && ((uint64_t)queue[q] + coins[c] <= span); c++) {
+					uint64_t total = (uint64_t)queue[q] + coins[c];
+
+					compares++;
+					if (!bit_test(seen, total)) {
+						seen[total / WORD_BITS] |= 1ULL << (total % WORD_BITS);
+						bitset_reach(total, k + 1, level, queue, &q_end, &lo, &hi);
+					}
+				}
+			}
+			q_start = level_end;
+			continue;
+		}
+
+		for (int64_t w = (int64_t)flo - 1; w <= (int64_t)fhi + 1; w++) {
+			frontier[w] = 0;
+		}
+		for (uint64_t q = q_start; q < level_end; q++) {
+			frontier[queue[q] / WORD_BITS] |= 1ULL << (queue[q] % WORD_BITS);
+		}
+		for (uint64_t w = nlo / WORD_BITS; w <= nhi / WORD_BITS; w++) {
+			next[w] = 0;
+		}
+
+		if (by_coin <= by_total) {
+			for (uint32_t c = 0; (c < n_coins) && (flo * WORD_BITS + coins[c] <= span); c++) {
+				shift_or(next, frontier, flo, fhi, coins[c], w_max);
+				compares += fw;
+			}
+		} else {
+			for (uint64_t q = q_start; q < level_end; q++) {
+				shift_or(next, coin_bits, 0, coin_words - 1, queue[q], w_max);
+				compares += coin_words;
+			}
+		}
+
+		// Keep only the totals reached for the first time, which are queued in increasing order
+		for (uint64_t w = nlo / WORD_BITS; w <= nhi / WORD_BITS; w++) {
+			uint64_t x = next[w] & ~seen[w];
+
+			(w == w_max) && (x &= (~0ULL >> (63 - (span % WORD_BITS))));
+			seen[w] |= x;
+			for (; x != 0; x &= x - 1) {
+				bitset_reach((w * WORD_BITS) + __builtin_ctzll(x), k + 1, level, queue, &q_end, &lo, &hi);
+			}
+		}
+		q_start = level_end;
+	}
+
+	if (stats) {
+		stats->compares += compares;
+		stats->enqueued += q_end - 1;
+		stats->levels += k;
+	}
+	return bit_test(seen, span) ? level[span] : 0;
+} // bitset_search
+
+
+// Walk back from span, each time taking the largest coin that leads to a total one level closer to zero
+static void
+bitset_reconstruct(const uint32_t coins[], const uint32_t n_coins, const uint32_t span, const uint32_t *level,
+		   const uint64_t *seen, minc_run_t *runs)
+{
+	for (uint32_t u = span; u > 0; ) {
+		for (uint32_t c = n_coins; c-- > 0; ) {
+			if ((coins[c] <= u) && bit_test(seen, u - coins[c]) && (level[u - coins[c]] == level[u] - 1)) {
+				runs[c].count++;
+				u -= coins[c];
+				break;
+			}
+		}
+	}
+} // bitset_reconstruct
+
+
+// Level-synchronous bitset search, with the leap-forward applied first
+int
+minc_solve_bitset(minc_solver_t *solver, const uint32_t coins[], uint32_t n_coins, const uint32_t target,
+		  minc_result_t *result, minc_stats_t *stats)
+{
+	uint64_t faults = stats ? get_minor_faults() : 0;
+	uint32_t leap, leap_coin, n_all, span, nr, n_words, coin_words, *level = NULL, *queue = NULL;
+	uint64_t *seen = NULL, *frontier = NULL, *next = NULL, *coin_bits = NULL;
+	table_t level_table = {0}, queue_table = {0}, seen_table = {0}, frontier_table = {0}, next_table = {0};
+	table_t coin_table = {0};
+	phase_mark_t mark;
+	prep_t prep;
+	int ret;
+
+	memset(result, 0, sizeof(*result));
+	result->target = target;
+
+	if ((ret = coins_prepare(&coins, &n_coins, target, &prep, stats)) <= 0) {
+		goto cleanup;
+	}
+	ret = -1;
+	leap = prep.leap;
+	leap_coin = coins[n_coins - 1];
+	n_all = n_coins;
+	span = prep.target - leap;
+
+	// Coins beyond the span can't be used in it, and the leap may already have made the whole target
+	for (; (n_coins > 0) && (coins[n_coins - 1] > span); n_coins--);
+	if ((span == 0) || (n_coins == 0)) {
+		nr = 0;
+		goto reconstruct;
+	}
+
+	n_words = (span / WORD_BITS) + 3;
+	coin_words = (coins[n_coins - 1] / WORD_BITS) + 3;
+	level = solver_table_get(solver, &level_table, ((size_t)span + 1) * sizeof(*level), 0);
+	queue = solver_table_get(solver, &queue_table, ((size_t)span + 1) * sizeof(*queue), 0);
+	seen = solver_table_get(solver, &seen_table, (size_t)n_words * sizeof(*seen), 1);
+	frontier = solver_table_get(solver, &frontier_table, (size_t)n_words * sizeof(*frontier), 0);
+	next = solver_table_get(solver, &next_table, (size_t)n_words * sizeof(*next), 0);
+	coin_bits = solver_table_get(solver, &coin_table, (size_t)coin_words * sizeof(*coin_bits), 1);
+	if (!level || !queue || !seen || !frontier || !next || !coin_bits) {
+		fprintf(stderr, "Line %d in %s:%s(): Out of memory\n", __LINE__, __FILE__, __func__);
+		goto cleanup;
+	}
+
+	// Every bitset is addressed from its second word, so that the word below the lowest total can be read as zero
+	for (uint32_t c = 0; c < n_coins; c++) {
+		coin_bits[1 + (coins[c] / WORD_BITS)] |= 1ULL << (coins[c] % WORD_BITS);
+	}
+
+	phase_begin(stats, &mark);
+	nr = bitset_search(coins, n_coins, span, level, queue, seen + 1, frontier + 1, next + 1, coin_bits + 1, stats);
+	phase_end(stats, MINC_PHASE_SEARCH, &mark);
+
+reconstruct:
+	phase_begin(stats, &mark);
+	if ((nr > 0) || ((span == 0) && (leap > 0))) {
+		if (result_begin(solver, result, coins, n_all) < 0) {
+			goto cleanup;
+		}
+		if (nr > 0) {
+			bitset_reconstruct(coins, n_coins, span, level, seen + 1, result->runs);
+		}
+		result->runs[n_all - 1].count += leap / leap_coin;
+		result_end(result, prep.set->gcd);
+	}
+	phase_end(stats, MINC_PHASE_RECONSTRUCT, &mark);
+	ret = 0;
+
+cleanup:
+	coins_release(&prep);
+	solver_table_put(solver, &level_table, 0, stats);
+	solver_table_put(solver, &queue_table, 0, stats);
+	solver_table_put(solver, &seen_table, 0, stats);
+	solver_table_put(solver, &frontier_table, 0, stats);
+	solver_table_put(solver, &next_table, 0, stats);
+	solver_table_put(solver, &coin_table, 0, stats);
+	if (stats) {
+		stats->queries++;
+		stats->pages += get_minor_faults() - faults;
+	}
+	return ret;
+} // minc_solve_bitset
@@ -0,0 +1,381 @@
+// Result cache
+//
+// Answers are keyed by the coin set's fingerprint and the target in units of its gcd, so that the same amount asked
+// of a coin set and of any multiple of it is one entry.  The cache is split into shards by the hash of the key, each
+// behind its own lock, so that concurrent workers seldom meet.  Each shard is a segmented LRU: a new answer goes into
+// the probationary segment, and only moves to the protected segment if it's asked for again.  A run of one-off
+// targets then only ever churns the probationary segment, and the answers that really are hot stay put.
+//
+// An answer is kept as runs of each coin used, and along with the line it was printed as, so that a server can send
+// a hot answer straight back out without walking a table or formatting it again.  The coin set is kept with it too,
+// and compared on every hit, so that two coin sets whose fingerprints collide can't be given each other's answers
+//
+// Author: Stew Forster (stew675@gmail.com)
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "mincoins_int.h"
+
+#define MAX_SHARDS	16
+#define NONE		UINT32_MAX
+#define PROTECTED_PCT	80		// Share of a shard's entries that may be protected
+
+enum { SEG_PROBATION = 0, SEG_PROTECTED, N_SEGS };
+
+typedef struct cache_entry {
+	uint64_t	fingerprint;
+	uint32_t	target;		// In units of the coin set's gcd
+	uint32_t	nr;		// Coins in the answer, or 0 if the target can't be made
+	uint32_t	n_runs;
+	uint32_t	n_coins;
+	uint32_t	line_gcd;	// The gcd the line was printed for, or 0 if there's no line
+	uint32_t	line_len;
+	uint32_t	seg;
+	uint32_t	prev, next;	// Neighbours in the entry's segment, most recently used first
+	uint32_t	chain;		// Next entry in the same hash bucket
+	void		*data;		// The runs, with coins in units of the coin set's gcd, then the set's coins, and
+					// then the line
+} cache_entry_t;
+
+typedef struct cache_shard {
+	pthread_mutex_t	lock;
+	cache_entry_t	*entries;
+	uint32_t	*buckets;
+	uint32_t	mask;
+	uint32_t	n_entries;
+	uint32_t	n_used;
+	uint32_t	head[N_SEGS], tail[N_SEGS], count[N_SEGS];
+	uint64_t	hits, misses, inserts, evictions;
+} __attribute__((aligned(64))) cache_shard_t;
+
+struct minc_cache {
+	uint32_t	n_shards;
+	uint32_t	max_entries;
+	cache_shard_t	shards[MAX_SHARDS];
+};
+
+
+static inline uint64_t
+cache_hash(const uint64_t fingerprint, const uint32_t target)
+{
+	uint64_t h = fingerprint ^ (target * 0x9e3779b97f4a7c15ULL);
+
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	return h;
+} // cache_hash
+
+
+static void
+seg_unlink(cache_shard_t *shard, const uint32_t e)
+{
+	cache_entry_t *entry = &shard->entries[e];
+
+	uint32_t *prev_link = (entry->prev != NONE) ? &shard->entries[entry->prev].next : &shard->head[entry->seg];
+	uint32_t *next_link = (entry->next != NONE) ? &shard->entries[entry->next].prev : &shard->tail[entry->seg];
+
+	*prev_link = entry->next;
+	*next_link = entry->prev;
+	shard->count[entry->seg]--;
+} // seg_unlink
+
+
+static void
+seg_push(cache_shard_t *shard, const uint32_t e, const uint32_t seg)
+{
+	cache_entry_t *entry = &shard->entries[e];
+
+	entry->seg = seg;
+	entry->prev = NONE;
+	entry->next = shard->head[seg];
+	(shard->head[seg] != NONE) ? (shard->entries[shard->head[seg]].prev = e) : (shard->tail[seg] = e);
+	shard->head[seg] = e;
+	shard->count[seg]++;
+} // seg_push
+
+
+// Take an entry out of its hash chain
+static void
+chain_unlink(cache_shard_t *shard, const uint32_t e)
+{
+	cache_entry_t *entry = &shard->entries[e];
+	uint32_t *link = &shard->buckets[cache_hash(entry->fingerprint, entry->target) & shard->mask];
+
+	for (; *link != e; link = &shard->entries[*link].chain);
+	*link = entry->chain;
+} // chain_unlink
+
+
+static cache_shard_t *
+cache_shard(minc_cache_t *cache, const uint64_t hash)
+{
+	return &cache->shards[(hash >> 56) % cache->n_shards];
+} // cache_shard
+
+
+// How many of the shard's entries may be protected, which is at least one
+static inline uint64_t
+protected_max(const cache_shard_t *shard)
+{
+	uint64_t n_protected = ((uint64_t)shard->n_entries * PROTECTED_PCT) / 100;
+
+	return (n_protected > 0) ? n_protected : 1;
+} // protected_max
+
+
+static inline uint32_t *
+entry_coins(const cache_entry_t *entry)
+{
+	return (uint32_t *)((minc_run_t *)entry->data + entry->n_runs);
+} // entry_coins
+
+
+static inline char *
+entry_line(const cache_entry_t *entry)
+{
+	return (char *)(entry_coins(entry) + entry->n_coins);
+} // entry_line
+
+
+static uint32_t
+shard_find(const cache_shard_t *shard, const uint64_t hash, const minc_coinset_t *set, const uint32_t target)
+{
+	uint32_t e = shard->buckets[hash & shard->mask];
+
+	for (; e != NONE; e = shard->entries[e].chain) {
+		const cache_entry_t *entry = &shard->entries[e];
+
+		if ((entry->fingerprint == set->fingerprint) && (entry->target == target) &&
+		    (entry->n_coins == set->n_coins) &&
+		    (memcmp(entry_coins(entry), set->coins, set->n_coins * sizeof(*set->coins)) == 0)) {
+			break;
+		}
+	}
+	return e;
+} // shard_find
+
+
+// Make a cache of up to max_entries answers.  Returns NULL if out of memory
+minc_cache_t *
+minc_cache_new(const uint32_t max_entries)
+{
+	minc_cache_t *cache;
+
+	if ((max_entries == 0) || ((cache = calloc(1, sizeof(*cache))) == NULL)) {
+		return NULL;
+	}
+	cache->n_shards = (max_entries < MAX_SHARDS) ? max_entries : MAX_SHARDS;
+	cache->max_entries = (max_entries / cache->n_shards) * cache->n_shards;
+
+	for (uint32_t s = 0; s < cache->n_shards; s++) {
+		cache_shard_t *shard = &cache->shards[s];
+		uint32_t n_buckets = 1;
+
+		shard->n_entries = max_entries / cache->n_shards;
+		while (n_buckets < shard->n_entries) {
+			n_buckets <<= 1;
+		}
+		shard->mask = n_buckets - 1;
+		shard->entries = malloc(shard->n_entries * sizeof(*shard->entries));
+		shard->buckets = malloc(n_buckets * sizeof(*shard->buckets));
+		pthread_mutex_init(&shard->lock, NULL);
+		if ((shard->entries == NULL) || (shard->buckets == NULL)) {
+			fprintf(stderr, "Line %d in %s:%s(): Out of memory\n", __LINE__, __FILE__, __func__);
+			cache->n_shards = s + 1;
+			minc_cache_free(cache);
+			return NULL;
+		}
+		memset(shard->buckets, 0xff, n_buckets * sizeof(*shard->buckets));
+		for (uint32_t seg = 0; seg < N_SEGS; seg++) {
+			shard->head[seg] = shard->tail[seg] = NONE;
+		}
+	}
+	return cache;
+} // minc_cache_new
+
+
+void
+minc_cache_free(minc_cache_t *cache)
+{
+	if (cache == NULL) {
+		return;
+	}
+	for (uint32_t s = 0; s < cache->n_shards; s++) {
+		cache_shard_t *shard = &cache->shards[s];
+
+		for (uint32_t e = 0; shard->entries && (e < shard->n_used); e++) {
+			free(shard->entries[e].data);
+		}
+		free(shard->entries);
+		free(shard->buckets);
+		pthread_mutex_destroy(&shard->lock);
+	}
+	free(cache);
+} // minc_cache_free
+
+
+// Look up target on the coin set.  On a hit the answer is written to result, from the solver's arena if there's a
+// solver, and if line isn't NULL it's pointed at a copy of the answer's printed line if there's one for this gcd,
+// or NULL if not.  Without a solver the copy must be freed.  Returns 1 on a hit, 0 on a miss, or -1 if out of memory
+int
+minc_cache_get(minc_cache_t *cache, const minc_coinset_t *set, const uint32_t target, minc_solver_t *solver,
+	       minc_result_t *result, const char **line)
+{
+	uint32_t t = target / set->gcd, e;
+	uint64_t hash = cache_hash(set->fingerprint, t);
+	cache_shard_t *shard = cache_shard(cache, hash);
+	cache_entry_t *entry;
+	char *copy = NULL;
+
+	memset(result, 0, sizeof(*result));
+	result->target = target;
+	line && (*line = NULL);
+	if ((target % set->gcd) != 0) {
+		return 0;
+	}
+
+	pthread_mutex_lock(&shard->lock);
+	if ((e = shard_find(shard, hash, set, t)) == NONE) {
+		shard->misses++;
+		pthread_mutex_unlock(&shard->lock);
+		return 0;
+	}
+	entry = &shard->entries[e];
+
+	if ((entry->n_runs > 0) &&
+	    ((result->runs = solver_alloc(solver, entry->n_runs * sizeof(*result->runs))) == NULL)) {
+		pthread_mutex_unlock(&shard->lock);
+		fprintf(stderr, "Line %d in %s:%s(): Out of memory\n", __LINE__, __FILE__, __func__);
+		return -1;
+	}
+	result->arena = solver;
+	for (uint32_t r = 0; r < entry->n_runs; r++) {
+		result->runs[r].coin = ((minc_run_t *)entry->data)[r].coin * set->gcd;
+		result->runs[r].count = ((minc_run_t *)entry->data)[r].count;
+	}
+	result->n_runs = entry->n_runs;
+	result->nr = entry->nr;
+
+	if (line && (entry->line_gcd == set->gcd) && ((copy = solver_alloc(solver, entry->line_len + 1)) != NULL)) {
+		memcpy(copy, entry_line(entry), entry->line_len + 1);
+		*line = copy;
+	}
+
+	// A second hit earns protection.  Whatever that pushes out of the protected segment gets one more chance.  A
+	// shard too small for its share to come to a whole entry still protects one, or the entry just promoted would
+	// be the one demoted again
+	seg_unlink(shard, e);
+	seg_push(shard, e, SEG_PROTECTED);
+	if (shard->count[SEG_PROTECTED] > protected_max(shard)) {
+		uint32_t demote = shard->tail[SEG_PROTECTED];
+
+		seg_unlink(shard, demote);
+		seg_push(shard, demote, SEG_PROBATION);
+	}
+	shard->hits++;
+	pthread_mutex_unlock(&shard->lock);
+	return 1;
+} // minc_cache_get
+
+
+// Remember an answer on the coin set, along with the line it was printed as, if line isn't NULL.  An answer that's
+// already cached only has its line filled in
+void
+minc_cache_put(minc_cache_t *cache, const minc_coinset_t *set, const minc_result_t *result, const char *line)
+{
+	uint32_t t = result->target / set->gcd, n_runs = result->n_runs, line_len = line ? strlen(line) : 0, e;
+	size_t coins_len = set->n_coins * sizeof(*set->coins);
+	uint64_t hash = cache_hash(set->fingerprint, t);
+	cache_shard_t *shard = cache_shard(cache, hash);
+	cache_entry_t *entry;
+	void *data, *old = NULL;
+
+	if ((result->target % set->gcd) != 0) {
+		return;
+	}
+
+	if ((data = malloc((n_runs * sizeof(minc_run_t)) + coins_len + line_len + 1)) == NULL) {
+		return;
+	}
+	for (uint32_t r = 0; r < n_runs; r++) {
+		((minc_run_t *)data)[r].coin = result->runs[r].coin / set->gcd;
+		((minc_run_t *)data)[r].count = result->runs[r].count;
+	}
+	memcpy((minc_run_t *)data + n_runs, set->coins, coins_len);
+	memcpy((uint8_t *)((minc_run_t *)data + n_runs) + coins_len, line ? line : "", line_len + 1);
+
+	pthread_mutex_lock(&shard->lock);
+	if ((e = shard_find(shard, hash, set, t)) != NONE) {
+		// Another thread got there first, so only the line is worth taking
+		entry = &shard->entries[e];
+		if (line && (entry->line_gcd == 0)) {
+			old = entry->data;
+			entry->data = data;
+			entry->n_runs = n_runs;
+			entry->line_gcd = set->gcd;
+			entry->line_len = line_len;
+			data = NULL;
+		}
+		pthread_mutex_unlock(&shard->lock);
+		free(data);
+		free(old);
+		return;
+	}
+
+	// Take an unused entry if there is one, and otherwise evict the least recently used, probationers first
+	if (shard->n_used < shard->n_entries) {
+		e = shard->n_used++;
+	} else {
+		e = (shard->tail[SEG_PROBATION] != NONE) ? shard->tail[SEG_PROBATION] : shard->tail[SEG_PROTECTED];
+		seg_unlink(shard, e);
+		chain_unlink(shard, e);
+		old = shard->entries[e].data;
+		shard->evictions++;
+	}
+
+	entry = &shard->entries[e];
+	entry->fingerprint = set->fingerprint;
+	entry->target = t;
+	entry->nr = result->nr;
+	entry->n_runs = n_runs;
+	entry->n_coins = set->n_coins;
+	entry->line_gcd = line ? set->gcd : 0;
+	entry->line_len = line_len;
+	entry->data = data;
+	entry->chain = shard->buckets[hash & shard->mask];
+	shard->buckets[hash & shard->mask] = e;
+	seg_push(shard, e, SEG_PROBATION);
+	shard->inserts++;
+	pthread_mutex_unlock(&shard->lock);
+	free(old);
+} // minc_cache_put
+
+
+void
+minc_cache_print(FILE *fp, minc_cache_t *cache)
+{
+	uint64_t hits = 0, misses = 0, inserts = 0, evictions = 0, used = 0, protected = 0;
+
+	for (uint32_t s = 0; s < cache->n_shards; s++) {
+		cache_shard_t *shard = &cache->shards[s];
+
+		pthread_mutex_lock(&shard->lock);
+		hits += shard->hits;
+		misses += shard->misses;
+		inserts += shard->inserts;
+		evictions += shard->evictions;
+		used += shard->n_used;
+		protected += shard->count[SEG_PROTECTED];
+		pthread_mutex_unlock(&shard->lock);
+	}
+
+	fprintf(fp, "Result cache: %lu of %u entries (%lu protected), %lu hits, %lu misses (%.1f%% hit), "
+		"%lu inserts, %lu evictions\n", (unsigned long)used, cache->max_entries, (unsigned long)protected,
+		(unsigned long)hits, (unsigned long)misses, (hits + misses) ? (100.0 * hits) / (hits + misses) : 0.0,
+		(unsigned long)inserts, (unsigned long)evictions);
+} // minc_cache_print
@@ -0,0 +1,142 @@
+// Closed-form and bounded-scan solvers for structured coin sets
+//
+// Some coin sets need no search at all.  The coin set analysis spots them, and these answer for them directly:
+//
+//   greedy	A canonical set, which includes every geometric series and the 1-2-5 decades of most currencies, is
+//		answered by taking as many of each coin as fit, largest first, in O(N)
+//   two	Coins a < b, coprime once divided through by their gcd.  Taking a b in place of b / a's worth of a
+//		always saves coins, so the fewest coins use as many b as possible, and as few a as possible.  That
+//		count of a is the least x with a * x = t modulo b, from a's inverse by extended Euclid, in O(log b)
+//   three	Coins a < b < c.  This one is no closed form, but a scan: for each count of b that an optimal solution
+//		might use, the rest is made from a and c as for two coins.  That's O(c / gcd(b, c)), which the
+//		analysis only allows up to 4096
+//
+// Author: Stew Forster (stew675@gmail.com)
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mincoins_int.h"
+
+// The inverse of a modulo m, which must be coprime to it
+static uint64_t
+inverse_mod(const uint64_t a, const uint64_t m)
+{
+	int64_t t = 0, new_t = 1, r = m, new_r = a % m, q, tmp;
+
+	while (new_r != 0) {
+		q = r / new_r;
+		tmp = t - (q * new_t);
+		t = new_t;
+		new_t = tmp;
+		tmp = r - (q * new_r);
+		r = new_r;
+		new_r = tmp;
+	}
+	return (t < 0) ? (t + (int64_t)m) : (uint64_t)t;
+} // inverse_mod
+
+
+// Make t from coprime coins a < b with the fewest coins, given a's inverse modulo b.  Returns how many coins that
+// takes, with x of a and y of b, or UINT64_MAX if t can't be made
+static inline uint64_t
+two_coins(const uint64_t a, const uint64_t b, const uint64_t inv, const uint64_t t, uint64_t *x, uint64_t *y)
+{
+	*x = ((t % b) * inv) % b;
+	if (a * *x > t) {
+		return UINT64_MAX;
+	}
+	*y = (t - (a * *x)) / b;
+	return *x + *y;
+} // two_coins
+
+
+// Closed-form engine.  Declines to run, returning -1, for coin sets without a structure it can answer for
+int
+minc_solve_closed(minc_solver_t *solver, const uint32_t coins[], uint32_t n_coins, const uint32_t target,
+		  minc_result_t *result, minc_stats_t *stats)
+{
+	const minc_coinset_t *set;
+	uint64_t t, x, y, z, best = UINT64_MAX, g, inv, tries;
+	phase_mark_t mark;
+	const uint32_t *c;
+	prep_t prep;
+	int ret;
+
+	memset(result, 0, sizeof(*result));
+	result->target = target;
+
+	// Larger coins may be pruned for a small target, but the closed forms work from the whole set
+	if ((ret = coins_prepare(&coins, &n_coins, target, &prep, stats)) < 0) {
+		return -1;
+	}
+	set = prep.set;
+	c = set->coins;
+	if (set->family == MINC_FAMILY_NONE) {
+		coins_release(&prep);
+		return -1;
+	}
+	if (ret == 0) {
+		goto done;
+	}
+	t = prep.target;
+
+	if ((ret = result_begin(solver, result, c, set->n_coins)) < 0) {
+		goto done;
+	}
+	phase_begin(stats, &mark);
+	switch (set->family) {
+	case MINC_FAMILY_GREEDY:
+		for (uint32_t i = set->n_coins; (t > 0) && (i-- > 0); t %= c[i]) {
+			result->runs[i].count = t / c[i];
+		}
+		break;
+	case MINC_FAMILY_TWO:
+		if (two_coins(c[0], c[1], inverse_mod(c[0], c[1]), t, &x, &y) != UINT64_MAX) {
+			result->runs[0].count = x;
+			result->runs[1].count = y;
+		}
+		break;
+	case MINC_FAMILY_THREE_SCAN:
+		g = find_gcd(c[0], c[2]);
+		inv = inverse_mod(c[0] / g, c[2] / g);
+		tries = c[2] / find_gcd(c[1], c[2]);
+		for (uint64_t n_mid = 0; (n_mid < tries) && (n_mid * c[1] <= t); n_mid++) {
+			uint64_t rest = t - (n_mid * c[1]), n;
+
+			if ((rest % g) || ((n = two_coins(c[0] / g, c[2] / g, inv, rest / g, &x, &z)) == UINT64_MAX)) {
+				continue;
+			}
+			if (n + n_mid < best) {
+				best = n + n_mid;
+				result->runs[0].count = x;
+				result->runs[1].count = n_mid;
+				result->runs[2].count = z;
+			}
+		}
+		break;
+	default:
+		break;
+	}
+	result_end(result, set->gcd);
+	phase_end(stats, MINC_PHASE_SEARCH, &mark);
+
+done:
+	coins_release(&prep);
+	stats && (ret == 0) && stats->queries++;
+	return ret;
+} // minc_solve_closed
+
+
+// Whether minc_solve_closed() declines the coin set, as it does those without a structure it can answer for
+int
+minc_closed_declines(const uint32_t coins[], const uint32_t n_coins)
+{
+	const minc_coinset_t *set = minc_coinset_get(coins, n_coins);
+	int declines = (set == NULL) || (set->family == MINC_FAMILY_NONE);
+
+	minc_coinset_put(set);
+	return declines;
+} // minc_closed_declines
@@ -0,0 +1,484 @@
+// Coin set preparation and analysis
+//
+// Before any search, a coin set is validated, has its zero and duplicate coins dropped, is sorted, and is divided
+// through by the GCD of its coins, since every reachable total is a multiple of that and the search can work in
+// those units instead.  The normalised set is then analysed once:
+//
+//   canonical	Whether the greedy choice of largest coin first is always optimal, by Pearson's O(N^3) test
+//   frobenius	The largest total that can't be made, from the least reachable total in each residue class modulo
+//		the smallest coin, as found by Böcker and Lipták's round-robin algorithm.  Those residues also tell
+//		at once whether any given total can be made
+//   period	The total from which every optimal solution uses the largest coin, so that answer(t) is
+//		answer(t - max_coin) + 1.  That's what licenses the search's leap forward
+//   family	Whether the set has a structure that the closed-form solvers in closed.c can answer for
+//
+// Analyses are cached, keyed by the coin set exactly as given, so that repeated queries on the same set just hash
+// the coins and take a reference
+//
+// Author: Stew Forster (stew675@gmail.com)
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "mincoins_int.h"
+
+#define CACHE_SLOTS		64
+#define CANONICAL_MAX_COINS	256			// Pearson's test is O(N^3)
+#define RESIDUE_MAX_COIN	(1U << 20)		// Largest smallest coin worth keeping residues for
+#define RESIDUE_MAX_WORK	(1ULL << 28)		// Most steps the round-robin may take
+#define RESIDUE_SAMPLES		256			// Residue classes looked at to estimate reachability
+#define THREE_MAX_SCAN		4096			// Most counts of the middle of three coins to scan
+
+typedef struct coinset_entry {
+	minc_coinset_t	set;
+	uint64_t	key_hash;
+	uint32_t	n_key;
+	uint32_t	*key;		// The coins exactly as given
+	uint32_t	refs;
+	uint64_t	last_used;
+} coinset_entry_t;
+
+static coinset_entry_t *cache[CACHE_SLOTS];
+static uint64_t cache_clock = 0;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+// Euclid's algorithm for greatest common divisor of 2 numbers
+uint64_t
+find_gcd(uint64_t a, uint64_t b)
+{
+	if (a == 0) {
+		return b;
+	}
+	while (b) {
+		uint64_t rem = a % b;
+
+		a = b;
+		b = rem;
+	}
+	return a;
+} // find_gcd
+
+
+// Find least common multiple of 2 numbers.  Return 0 on a uint32_t overflow
+static uint32_t
+find_lcm(const uint32_t a, const uint32_t b)
+{
+	if ((a == 0) || (b == 0)) {
+		return 0;
+	}
+
+	uint64_t lcm = (uint64_t)a * b;	// Widen before multiplying, or the overflow check below can't see it
+
+	lcm /= find_gcd(a, b);
+
+	return ((lcm > UINT32_MAX) ? 0 : lcm);
+} // find_lcm
+
+
+// Find the least common multiple of all the coins
+static uint32_t
+get_coins_lcm(const uint32_t coins[], const uint32_t n_coins)
+{
+	if (n_coins < 1) {
+		return 0;
+	}
+
+	uint32_t lcm = coins[0];
+	for (int c = 1; c < n_coins; c++) {
+		lcm = find_lcm(lcm, coins[c]);
+	}
+	return lcm;
+} // get_coins_lcm
+
+
+// FNV-1a over the coin values
+static uint64_t
+coins_hash(const uint32_t coins[], const uint32_t n_coins)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	for (uint32_t c = 0; c < n_coins; c++) {
+		for (int b = 0; b < 32; b += 8) {
+			hash = (hash ^ ((coins[c] >> b) & 0xff)) * 0x100000001b3ULL;
+		}
+	}
+	return hash;
+} // coins_hash
+
+
+// Number of coins the greedy choice uses to make total, or UINT64_MAX if it gets stuck.  desc[] is decreasing
+static uint64_t
+greedy_count(const uint32_t desc[], const uint32_t n_coins, uint64_t total)
+{
+	uint64_t count = 0;
+
+	for (uint32_t c = 0; (c < n_coins) && (total > 0); c++) {
+		count += total / desc[c];
+		total %= desc[c];
+	}
+	return (total == 0) ? count : UINT64_MAX;
+} // greedy_count
+
+
+// Pearson's test.  For each pair i <= j, take the greedy solution for one less than the coin before i, keep its
+// coins above j, and add one more of coin j.  If the greedy choice is ever beaten, it's beaten on one of those
+// totals.  Returns the smallest total greedy fails on, or 0 if it never does
+static uint64_t
+find_greedy_failure(const uint32_t coins[], const uint32_t n_coins)
+{
+	uint32_t desc[n_coins];
+	uint64_t greedy[n_coins], smallest = 0;
+
+	for (uint32_t c = 0; c < n_coins; c++) {
+		desc[c] = coins[n_coins - 1 - c];
+	}
+
+	for (uint32_t i = 1; i < n_coins; i++) {
+		uint64_t rem = desc[i - 1] - 1, value = 0, count = 0;
+
+		for (uint32_t c = 0; c < n_coins; c++) {
+			greedy[c] = rem / desc[c];
+			rem %= desc[c];
+		}
+		for (uint32_t j = i; j < n_coins; j++) {
+			uint64_t total = value + ((greedy[j] + 1) * desc[j]);
+
+			if ((greedy_count(desc, n_coins, total) > count + greedy[j] + 1) &&
+			    ((smallest == 0) || (total < smallest))) {
+				smallest = total;
+			}
+			value += greedy[j] * desc[j];
+			count += greedy[j];
+		}
+	}
+	return smallest;
+} // find_greedy_failure
+
+
+// Böcker and Lipták's round-robin algorithm, filling residues[r] with the least total congruent to r modulo the
+// smallest coin that the coins can make.  The coins must have a GCD of 1, so that every class is reachable
+static void
+find_residues(const uint32_t coins[], const uint32_t n_coins, uint64_t *residues)
+{
+	uint32_t a0 = coins[0];
+
+	residues[0] = 0;
+	for (uint32_t r = 1; r < a0; r++) {
+		residues[r] = UINT64_MAX;
+	}
+
+	for (uint32_t i = 1; i < n_coins; i++) {
+		uint32_t d = find_gcd(a0, coins[i]);
+
+		for (uint32_t p = 0; p < d; p++) {
+			uint64_t n = UINT64_MAX;
+
+			for (uint32_t q = p; q < a0; q += d) {
+				(residues[q] < n) && (n = residues[q]);
+			}
+			if (n == UINT64_MAX) {
+				continue;
+			}
+			for (uint32_t step = 1; step < a0 / d; step++) {
+				uint32_t r;
+
+				n += coins[i];
+				r = n % a0;
+				(residues[r] < n) && (n = residues[r]);
+				residues[r] = n;
+			}
+		}
+	}
+} // find_residues
+
+
+// Analyse a prepared coin set.  Returns -1 if out of memory
+static int
+coinset_analyse(minc_coinset_t *set)
+{
+	uint32_t n_coins = set->n_coins, a0 = set->coins[0], max_coin = set->coins[n_coins - 1];
+	uint64_t pairwise = 0;
+
+	set->lcm = get_coins_lcm(set->coins, n_coins);
+
+	// Without a unit coin greedy gets stuck on totals that can be made, unless there's only the one coin
+	set->greedy_fail = 0;
+	if (n_coins == 1) {
+		set->canonical = 1;
+	} else if (a0 > 1) {
+		set->canonical = 0;
+	} else if (n_coins > CANONICAL_MAX_COINS) {
+		set->canonical = -1;
+	} else {
+		set->greedy_fail = find_greedy_failure(set->coins, n_coins);
+		set->canonical = (set->greedy_fail == 0);
+	}
+
+	set->frobenius = -2;
+	if (a0 == 1) {
+		set->frobenius = -1;
+	} else if ((a0 <= RESIDUE_MAX_COIN) && ((uint64_t)n_coins * a0 <= RESIDUE_MAX_WORK)) {
+		uint64_t most = 0;
+
+		if ((set->residues = malloc(a0 * sizeof(*set->residues))) == NULL) {
+			return -1;
+		}
+		find_residues(set->coins, n_coins, set->residues);
+		for (uint32_t r = 0; r < a0; r++) {
+			(set->residues[r] > most) && (most = set->residues[r]);
+		}
+		set->n_residues = a0;
+		set->frobenius = most - a0;
+	}
+
+	// An optimal solution without the largest coin can't hold max_coin or more coins, as some of them would sum
+	// to a multiple of it and could be swapped for fewer.  Nor can it hold lcm(c, max_coin) / c of any coin c.
+	// Take the least.  The LCM of the whole set is no bound at all, as {12, 21, 28} makes 135 only without a 28.  The
+	// pairwise sum is given up on once it's no longer the lesser, and saturates, so that large coins can't wrap it
+	set->period = ((uint64_t)(max_coin - 1) * (max_coin - 1)) + 1;
+	for (uint32_t c = 0; (c < n_coins - 1) && (pairwise < set->period); c++) {
+		uint64_t most = (((uint64_t)set->coins[c] * max_coin) / find_gcd(set->coins[c], max_coin)) - set->coins[c];
+
+		pairwise = (most > UINT64_MAX - pairwise) ? UINT64_MAX : pairwise + most;
+	}
+	(pairwise < set->period) && (set->period = pairwise + 1);
+
+	// An optimal solution from three coins never needs max_coin / gcd(mid, max_coin) or more of the middle one, as
+	// they could be swapped for fewer of the largest
+	set->family = MINC_FAMILY_NONE;
+	if (set->canonical > 0) {
+		set->family = MINC_FAMILY_GREEDY;
+	} else if (n_coins == 2) {
+		set->family = MINC_FAMILY_TWO;
+	} else if ((n_coins == 3) && (max_coin / find_gcd(set->coins[1], max_coin) <= THREE_MAX_SCAN)) {
+		set->family = MINC_FAMILY_THREE_SCAN;
+	}
+
+	set->fingerprint = coins_hash(set->coins, n_coins);
+	return 0;
+} // coinset_analyse
+
+
+static void
+coinset_free(coinset_entry_t *entry)
+{
+	free(entry->set.coins);
+	free(entry->set.residues);
+	free(entry->key);
+	free(entry);
+} // coinset_free
+
+
+// Validate, sort, deduplicate and normalise a coin set, and analyse it.  Returns NULL if it has no non-zero coins,
+// or if out of memory
+static coinset_entry_t *
+coinset_build(const uint32_t coins[], const uint32_t n_coins, const uint64_t key_hash)
+{
+	coinset_entry_t *entry = calloc(1, sizeof(*entry));
+	minc_coinset_t *set;
+	uint32_t n = 0, gcd = 0;
+
+	if ((entry == NULL) || ((entry->key = malloc((n_coins + 1) * sizeof(*entry->key))) == NULL) ||
+	    ((entry->set.coins = malloc((n_coins + 1) * sizeof(*entry->set.coins))) == NULL)) {
+		fprintf(stderr, "Line %d in %s:%s(): Out of memory\n", __LINE__, __FILE__, __func__);
+		entry ? coinset_free(entry) : (void)0;
+		return NULL;
+	}
+	set = &entry->set;
+	memcpy(entry->key, coins, n_coins * sizeof(*coins));
+	entry->n_key = n_coins;
+	entry->key_hash = key_hash;
+
+	for (uint32_t c = 0; c < n_coins; c++) {
+		if (coins[c] > 0) {
+			set->coins[n++] = coins[c];
+			gcd = find_gcd(gcd, coins[c]);
+		}
+	}
+	if (n == 0) {
+		coinset_free(entry);
+		return NULL;
+	}
+
+	qsort(set->coins, n, sizeof(set->coins[0]), uint32_cmp);
+	set->n_coins = 0;
+	for (uint32_t c = 0; c < n; c++) {
+		if ((set->n_coins == 0) || (set->coins[c] != set->coins[set->n_coins - 1])) {
+			set->coins[set->n_coins++] = set->coins[c];
+		}
+	}
+	set->gcd = gcd;
+	for (uint32_t c = 0; c < set->n_coins; c++) {
+		set->coins[c] /= gcd;
+	}
+
+	if (coinset_analyse(set) < 0) {
+		fprintf(stderr, "Line %d in %s:%s(): Out of memory\n", __LINE__, __FILE__, __func__);
+		coinset_free(entry);
+		return NULL;
+	}
+	return entry;
+} // coinset_build
+
+
+// Look a coin set up in the cache, which must be locked.  If it isn't there, *victim is left as the slot to put it
+// in, or CACHE_SLOTS if every slot is held
+static coinset_entry_t *
+cache_find(const uint32_t coins[], const uint32_t n_coins, const uint64_t key_hash, uint32_t *victim)
+{
+	*victim = CACHE_SLOTS;
+	for (uint32_t s = 0; s < CACHE_SLOTS; s++) {
+		coinset_entry_t *e = cache[s];
+
+		if ((e != NULL) && (e->key_hash == key_hash) && (e->n_key == n_coins) &&
+		    !memcmp(e->key, coins, n_coins * sizeof(*coins))) {
+			return e;
+		}
+
+		// Prefer an empty slot, and otherwise the least recently used entry that nothing is still holding
+		if (e == NULL) {
+			((*victim == CACHE_SLOTS) || (cache[*victim] != NULL)) && (*victim = s);
+		} else if ((e->refs == 0) && ((*victim == CACHE_SLOTS) ||
+			   ((cache[*victim] != NULL) && (e->last_used < cache[*victim]->last_used)))) {
+			*victim = s;
+		}
+	}
+	return NULL;
+} // cache_find
+
+
+// Get the analysis of a coin set, from the cache if it's been seen before.  It must be released again with
+// minc_coinset_put().  A set that isn't cached is analysed without holding the cache lock, so that one costly
+// analysis doesn't hold up every other query.  If another thread cached the same set meanwhile, theirs is used and
+// this one thrown away.  Returns NULL if the set has no non-zero coins, or if out of memory
+const minc_coinset_t *
+minc_coinset_get(const uint32_t coins[], const uint32_t n_coins)
+{
+	uint64_t key_hash = coins_hash(coins, n_coins);
+	coinset_entry_t *entry, *built = NULL;
+	uint32_t victim;
+
+	pthread_mutex_lock(&cache_lock);
+	if ((entry = cache_find(coins, n_coins, key_hash, &victim)) == NULL) {
+		pthread_mutex_unlock(&cache_lock);
+		if ((built = coinset_build(coins, n_coins, key_hash)) == NULL) {
+			return NULL;
+		}
+		pthread_mutex_lock(&cache_lock);
+		entry = cache_find(coins, n_coins, key_hash, &victim);
+	}
+
+	if (entry != NULL) {
+		built ? coinset_free(built) : (void)0;
+	} else if (victim < CACHE_SLOTS) {
+		cache[victim] ? coinset_free(cache[victim]) : (void)0;
+		entry = cache[victim] = built;
+	} else {
+		// Every slot is held, so this one is left uncached, and is freed when it's released
+		entry = built;
+		entry->last_used = UINT64_MAX;
+	}
+
+	entry->refs++;
+	(entry->last_used != UINT64_MAX) && (entry->last_used = ++cache_clock);
+	pthread_mutex_unlock(&cache_lock);
+	return &entry->set;
+} // minc_coinset_get
+
+
+void
+minc_coinset_put(const minc_coinset_t *set)
+{
+	coinset_entry_t *entry = (coinset_entry_t *)set;
+
+	if (entry == NULL) {
+		return;
+	}
+	pthread_mutex_lock(&cache_lock);
+	if ((--entry->refs == 0) && (entry->last_used == UINT64_MAX)) {
+		coinset_free(entry);
+	}
+	pthread_mutex_unlock(&cache_lock);
+} // minc_coinset_put
+
+
+// Estimate how many of the totals from 0 to span can be made, in units of the gcd.  With the residues known, every
+// total in a class from its least reachable total on can be made, so that's exact, or very nearly from a sample of
+// the classes when there are many of them.  Otherwise it's bounded by how many different sums of each number of
+// coins there can be, which for a large smallest coin is far fewer than span
+uint64_t
+coinset_reachable(const minc_coinset_t *set, const uint32_t span)
+{
+	uint32_t a0 = set->coins[0], max_coin = set->coins[set->n_coins - 1];
+	uint64_t count = 0, sums = 1, sampled = 0;
+
+	if ((set->frobenius == -1) || ((set->frobenius >= 0) && (span > set->frobenius))) {
+		return (uint64_t)span + 1;
+	}
+
+	if (set->n_residues) {
+		uint32_t step = (a0 > RESIDUE_SAMPLES) ? (a0 / RESIDUE_SAMPLES) : 1;
+
+		for (uint32_t r = 0; r < a0; r += step, sampled++) {
+			(set->residues[r] <= span) && (count += ((span - set->residues[r]) / a0) + 1);
+		}
+		return (count * a0) / sampled;
+	}
+
+	// The sums of k coins all lie between k * a0 and k * max_coin, and there are at most C(n + k - 1, k) of them
+	for (uint64_t k = 0; (k * a0 <= span) && (count <= span); k++) {
+		uint64_t width = k * (max_coin - a0) + 1, room = span - (k * a0) + 1;
+
+		(width > room) && (width = room);
+		count += (sums < width) ? sums : width;
+		if (__builtin_mul_overflow(sums, set->n_coins + k, &sums) || (sums / (k + 1) > span)) {
+			sums = (uint64_t)span + 1;
+		} else {
+			sums /= k + 1;
+		}
+	}
+	return (count <= span) ? count : (uint64_t)span + 1;
+} // coinset_reachable
+
+
+void
+minc_coinset_print(FILE *fp, const minc_coinset_t *set)
+{
+	fprintf(fp, "\nCoin set analysis\n");
+	fprintf(fp, "  coins           ");
+	for (uint32_t c = 0; c < set->n_coins; c++) {
+		fprintf(fp, "%s%lu", c ? ", " : "", (unsigned long)set->coins[c] * set->gcd);
+	}
+	fprintf(fp, "\n  gcd             %u\n", set->gcd);
+	set->lcm ? fprintf(fp, "  lcm             %lu\n", (unsigned long)set->lcm * set->gcd) :
+		   fprintf(fp, "  lcm             overflows 32 bits\n");
+
+	if (set->canonical > 0) {
+		fprintf(fp, "  canonical       yes, greedy is always optimal\n");
+	} else if (set->greedy_fail) {
+		fprintf(fp, "  canonical       no, greedy first fails at %lu\n", (unsigned long)(set->greedy_fail * set->gcd));
+	} else {
+		fprintf(fp, "  canonical       %s\n", set->canonical ? "unknown, too many coins to check" : "no");
+	}
+
+	if (set->frobenius == -1) {
+		fprintf(fp, "  frobenius       none, every multiple of the gcd can be made\n");
+	} else if (set->frobenius == -2) {
+		fprintf(fp, "  frobenius       unknown, too costly to find\n");
+	} else {
+		fprintf(fp, "  frobenius       %lu\n", (unsigned long)(set->frobenius * set->gcd));
+	}
+	fprintf(fp, "  period          %lu\n", (unsigned long)(set->period * set->gcd));
+	if (set->family == MINC_FAMILY_THREE_SCAN) {
+		fprintf(fp, "  closed form     none, but a scan of %lu counts of the middle coin\n",
+			(unsigned long)(set->coins[2] / find_gcd(set->coins[1], set->coins[2])));
+	} else {
+		fprintf(fp, "  closed form     %s\n", (set->family == MINC_FAMILY_GREEDY) ? "greedy" :
+						   (set->family == MINC_FAMILY_TWO) ? "two coins, by extended Euclid" : "none");
+	}
+	fprintf(fp, "  fingerprint     %016lx\n", (unsigned long)set->fingerprint);
+} // minc_coinset_print
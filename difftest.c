@@ -0,0 +1,623 @@
+// Randomised differential tester for the minimum coins search engines
+//
+// Generates coin sets and targets, runs every engine on them, and checks each answer against a simple dynamic
+// programming oracle.  The coin count must match the oracle, and the breakdown must use only coins from the set,
+// be in increasing order, and sum to the target.  A failing case is shrunk, by dropping coins and lowering the
+// target for as long as it still fails, before being reported.  An engine that fails to run is a failure too, unless
+// it's one that declines the coin set.
+//
+// Shared tables are checked the same way, total by total against the oracle, built in memory, in the background
+// while they're read, into a table store that they're then extended in and mapped back from, and out of core.  So
+// is a build that's cut short after a checkpoint, and then carried on from there
+//
+// Author: Stew Forster (stew675@gmail.com)
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <dirent.h>
+#include <sys/wait.h>
+
+#include "mincoins.h"
+
+#define MAX_COINS	12
+#define TABLE_MAX	(1U << 20)		// Largest table built, other than out of core
+#define TABLE_CHECKS	65536			// Most totals looked up in each table
+#define STREAM_MIN	((1U << 24) + 1)	// An out of core table goes past the first 16M total segment
+#define RESUME_SPAN	200000000U		// A build long enough to be cut short after a checkpoint
+#define RESUME_NS	2500000000ULL		// How long that's left to go, with checkpoints every second
+#define RESUME_CHECKS	4096			// Totals looked up in it, which are long walks before the leap
+
+typedef struct testcase {
+	uint32_t	n_coins;
+	uint32_t	coins[MAX_COINS];
+	uint32_t	target;
+} testcase_t;
+
+static struct {
+	uint64_t	iterations;
+	uint64_t	seed;
+	uint32_t	max_target;
+	const char	*engine;
+	uint32_t	tables;
+	int		verbose;
+} opts = { 10000, 1, 100000, NULL, 20, 0 };
+
+// The ways a table is built to be checked
+enum { TABLE_MEMORY = 0, TABLE_BACKGROUND, TABLE_STORE, TABLE_STREAM, TABLE_N_MODES };
+static const char *table_modes[TABLE_N_MODES] = { "memory", "background", "store", "stream" };
+static char store_dir[] = "/tmp/minc_difftest.XXXXXX";
+
+// Cases that have gone wrong before, run ahead of the random ones every time
+static const testcase_t regressions[] = {
+	{ 3, { 12, 21, 28 }, 135 },	// Past lcm + max_coin, yet only made without the largest coin
+	{ 3, { 24, 42, 56 }, 3294 },	// Which a leap from there left out of reach altogether
+};
+
+// One solver is used throughout, so that every case also checks the tables it inherits were left clean
+static minc_solver_t *solver = NULL;
+
+
+// Simple LCG so that a seed reproduces the same cases everywhere
+static uint32_t
+test_rand(uint64_t *state)
+{
+	*state = (*state * 6364136223846793005ULL) + 1442695040888963407ULL;
+	return (uint32_t)(*state >> 32);
+} // test_rand
+
+
+// Returns a value in [lo, hi], spread logarithmically so that small and huge values are both common
+static uint32_t
+rand_log(uint64_t *state, const uint32_t lo, const uint32_t hi)
+{
+	uint32_t bits = 1 + (test_rand(state) % 32), val = test_rand(state);
+
+	val = (bits < 32) ? (val & ((1U << bits) - 1)) : val;
+	return lo + (val % (hi - lo + 1));
+} // rand_log
+
+
+static void
+generate_case(uint64_t *state, testcase_t *tc)
+{
+	uint32_t style = test_rand(state) % 4;
+
+	// Now and then, coins just above 2^16 whose products wrap 32 bits, with targets far enough beyond them that
+	// the search would leap forward if the pairwise LCMs of the period were miscalculated.  These ignore max_target
+	if (test_rand(state) % 16 == 0) {
+		tc->n_coins = 3;
+		tc->coins[0] = 1 + (test_rand(state) % 20);
+		tc->coins[1] = 65536 + (test_rand(state) % 64);
+		tc->coins[2] = 65536 + (test_rand(state) % 64);
+		tc->target = ((1 + (test_rand(state) % 40)) * 65536) + (test_rand(state) % 65536);
+		return;
+	}
+
+	tc->n_coins = 1 + (test_rand(state) % 8);
+	for (uint32_t c = 0; c < tc->n_coins; c++) {
+		switch (style) {
+		case 0:	tc->coins[c] = 1 + (test_rand(state) % 20); break;		// Small, many collisions
+		case 1:	tc->coins[c] = 1 + (test_rand(state) % 1000); break;		// Typical currencies
+		case 2:	tc->coins[c] = rand_log(state, 1, UINT32_MAX - 1); break;	// Anything at all
+		default: tc->coins[c] = rand_log(state, 1, 1U << 20); break;		// Big enough to overflow the LCM
+		}
+	}
+
+	// Often include a unit coin, so that every target is reachable
+	(test_rand(state) % 3 == 0) && (tc->coins[0] = 1);
+
+	// Mostly moderate targets, with the occasional one up to the limit
+	if (test_rand(state) % 10 == 0) {
+		tc->target = 1 + (test_rand(state) % opts.max_target);
+	} else {
+		tc->target = 1 + (test_rand(state) % ((opts.max_target / 20) + 1));
+	}
+
+	// Now and then, a common factor across the coins, with the target mostly a multiple of it
+	if ((style < 2) && (test_rand(state) % 8 == 0)) {
+		uint32_t factor = 2 + (test_rand(state) % 30);
+
+		for (uint32_t c = 0; c < tc->n_coins; c++) {
+			tc->coins[c] *= factor;
+		}
+		(test_rand(state) % 4 != 0) && (tc->target -= tc->target % factor);
+	}
+} // generate_case
+
+
+// The oracle: plain O(N * T) dynamic programming over every total up to the case's target, with UINT32_MAX for
+// those that can't be made.  The caller frees it
+static uint32_t *
+oracle_table(const testcase_t *tc)
+{
+	uint32_t *dp = malloc(((uint64_t)tc->target + 1) * sizeof(*dp));
+
+	if (dp == NULL) {
+		fprintf(stderr, "Line %d in %s:%s(): Out of memory\n", __LINE__, __FILE__, __func__);
+		exit(2);
+	}
+
+	dp[0] = 0;
+	for (uint32_t t = 1; t <= tc->target; t++) {
+		dp[t] = UINT32_MAX;
+		for (uint32_t c = 0; c < tc->n_coins; c++) {
+			if ((tc->coins[c] <= t) && (dp[t - tc->coins[c]] != UINT32_MAX) && (dp[t - tc->coins[c]] + 1 < dp[t])) {
+				dp[t] = dp[t - tc->coins[c]] + 1;
+			}
+		}
+	}
+	return dp;
+} // oracle_table
+
+
+// Returns UINT32_MAX if the target is unreachable
+static uint32_t
+oracle(const testcase_t *tc)
+{
+	uint32_t *dp = oracle_table(tc), ans = dp[tc->target];
+
+	free(dp);
+	return ans;
+} // oracle
+
+
+// Check an answer for target made from the case's coins.  Returns 0 if it agreed with the oracle, or 1 with a
+// description of the disagreement in why[]
+static int
+check_result(const testcase_t *tc, const uint32_t target, const uint32_t expect, const minc_result_t *result,
+	     char *why, size_t why_len)
+{
+	uint64_t sum = 0, count = 0;
+
+	if ((expect == UINT32_MAX) && (result->nr != 0)) {
+		snprintf(why, why_len, "found %u coins for an unreachable target", result->nr);
+		return 1;
+	} else if ((expect != UINT32_MAX) && (result->nr != expect)) {
+		snprintf(why, why_len, "found %u coins, but the minimum is %u", result->nr, expect);
+		return 1;
+	}
+
+	for (uint32_t r = 0; r < result->n_runs; r++) {
+		uint32_t c;
+
+		for (c = 0; (c < tc->n_coins) && (tc->coins[c] != result->runs[r].coin); c++);
+		if (c == tc->n_coins) {
+			snprintf(why, why_len, "breakdown uses %u, which is not in the coin set", result->runs[r].coin);
+			return 1;
+		} else if ((r > 0) && (result->runs[r].coin <= result->runs[r - 1].coin)) {
+			snprintf(why, why_len, "breakdown is not in increasing order of coin");
+			return 1;
+		} else if (result->runs[r].count == 0) {
+			snprintf(why, why_len, "breakdown has an empty run of %u", result->runs[r].coin);
+			return 1;
+		}
+		count += result->runs[r].count;
+		sum += (uint64_t)result->runs[r].coin * result->runs[r].count;
+	}
+	if (count != result->nr) {
+		snprintf(why, why_len, "breakdown has %lu coins, not %u", (unsigned long)count, result->nr);
+		return 1;
+	}
+	if ((result->nr > 0) && (sum != target)) {
+		snprintf(why, why_len, "breakdown sums to %lu, not the target", (unsigned long)sum);
+		return 1;
+	}
+	return 0;
+} // check_result
+
+
+// Run one engine on one case.  Returns 0 if it agreed with the oracle, or declined a coin set it says it declines,
+// or 1 with a description of the disagreement in why[]
+static int
+check_engine(const minc_engine_t *eng, const testcase_t *tc, const uint32_t expect, char *why, size_t why_len)
+{
+	uint32_t coins[MAX_COINS];
+	minc_result_t result;
+	int bad;
+
+	memcpy(coins, tc->coins, sizeof(coins));
+	if (eng->solve(solver, coins, tc->n_coins, tc->target, &result, NULL) < 0) {
+		minc_solver_reset(solver);
+		if (eng->declines && eng->declines(tc->coins, tc->n_coins)) {
+			return 0;
+		}
+		snprintf(why, why_len, "failed to run");
+		return 1;
+	}
+
+	if (memcmp(coins, tc->coins, tc->n_coins * sizeof(*coins))) {
+		snprintf(why, why_len, "rewrote the caller's coins[]");
+		bad = 1;
+	} else {
+		bad = check_result(tc, tc->target, expect, &result, why, why_len);
+	}
+
+	minc_free_result(&result);
+	minc_solver_reset(solver);
+	return bad;
+} // check_engine
+
+
+static int
+case_fails(const minc_engine_t *eng, const testcase_t *tc, char *why, size_t why_len)
+{
+	return check_engine(eng, tc, oracle(tc), why, why_len);
+} // case_fails
+
+
+// Greedily simplify a failing case for as long as it keeps failing
+static void
+shrink_case(const minc_engine_t *eng, testcase_t *tc, char *why, size_t why_len)
+{
+	for (int progress = 1; progress; ) {
+		testcase_t tr;
+
+		progress = 0;
+
+		// Try dropping each coin in turn
+		for (uint32_t c = 0; (c < tc->n_coins) && (tc->n_coins > 1); c++) {
+			tr = *tc;
+			memmove(&tr.coins[c], &tr.coins[c + 1], (tr.n_coins - c - 1) * sizeof(tr.coins[0]));
+			tr.n_coins--;
+			if (case_fails(eng, &tr, why, why_len)) {
+				*tc = tr;
+				progress = 1;
+				c--;
+			}
+		}
+
+		// Try smaller targets, from big steps down to single units
+		for (uint32_t step = tc->target / 2; step > 0; step /= 2) {
+			tr = *tc;
+			tr.target -= step;
+			if ((tr.target > 0) && case_fails(eng, &tr, why, why_len)) {
+				*tc = tr;
+				progress = 1;
+				break;
+			}
+		}
+
+		// Try making each coin smaller
+		for (uint32_t c = 0; c < tc->n_coins; c++) {
+			tr = *tc;
+			tr.coins[c] /= 2;
+			if ((tr.coins[c] > 0) && case_fails(eng, &tr, why, why_len)) {
+				*tc = tr;
+				progress = 1;
+			}
+		}
+	}
+
+	// Leave why[] describing the final case
+	case_fails(eng, tc, why, why_len);
+} // shrink_case
+
+
+static void
+print_case(FILE *fp, const testcase_t *tc)
+{
+	fprintf(fp, "coins {");
+	for (uint32_t c = 0; c < tc->n_coins; c++) {
+		fprintf(fp, "%s%u", c ? ", " : "", tc->coins[c]);
+	}
+	fprintf(fp, "} target %u", tc->target);
+} // print_case
+
+
+// Run every engine asked for on one case, reporting and shrinking any that get it wrong.  Returns how many did
+static uint32_t
+run_case(const testcase_t *tc, const char *label, const uint64_t i)
+{
+	uint32_t expect = oracle(tc), failures = 0;
+	char why[256];
+
+	if (opts.verbose) {
+		printf("%s %lu: ", label, (unsigned long)i);
+		print_case(stdout, tc);
+		printf("\n");
+	}
+
+	for (uint32_t e = 0; e < minc_n_engines; e++) {
+		const minc_engine_t *eng = &minc_engines[e];
+
+		if ((opts.engine != NULL) && strcmp(opts.engine, eng->name)) {
+			continue;
+		}
+		if (check_engine(eng, tc, expect, why, sizeof(why))) {
+			testcase_t small = *tc;
+
+			failures++;
+			printf("FAIL %s on %s %lu: ", eng->name, label, (unsigned long)i);
+			print_case(stdout, tc);
+			printf("\n  %s\n", why);
+
+			shrink_case(eng, &small, why, sizeof(why));
+			printf("  shrunk to: ");
+			print_case(stdout, &small);
+			printf("\n  %s\n", why);
+			fflush(stdout);
+		}
+	}
+	return failures;
+} // run_case
+
+
+// Look totals up in a table, waiting on any it hasn't got to yet, and check them against the oracle's dp[].  Every
+// total is checked in a small table, and an even spread of n_checks of them in a large one, always including the last
+static int
+check_lookups(const minc_table_t *table, const testcase_t *tc, const uint32_t *dp, const uint32_t n_checks,
+	      char *why, size_t why_len)
+{
+	uint32_t step = (tc->target / n_checks) + 1;
+	minc_result_t result;
+	int bad = 0, ret;
+
+	for (uint64_t t = 0; !bad && (t <= tc->target); t = ((t < tc->target) && (t + step > tc->target)) ?
+							      tc->target : t + step) {
+		while ((ret = minc_table_lookup(table, solver, t, &result, NULL)) > 0) {
+			sched_yield();
+		}
+		if (ret < 0) {
+			snprintf(why, why_len, "lookup of %lu failed", (unsigned long)t);
+			bad = 1;
+		} else if (check_result(tc, t, dp[t], &result, why, why_len)) {
+			size_t len = strlen(why);
+
+			snprintf(why + len, why_len - len, ", for %lu", (unsigned long)t);
+			bad = 1;
+		}
+		minc_free_result(&result);
+		minc_solver_reset(solver);
+	}
+	return bad;
+} // check_lookups
+
+
+// Build a table for the case's coins out to its target the way mode says, and check it against the oracle.
+// Returns 0 if it agreed, or 1 with a description of the disagreement in why[]
+static int
+check_table(const testcase_t *tc, const int mode, char *why, size_t why_len)
+{
+	uint32_t *dp = oracle_table(tc);
+	minc_table_t *table;
+	int bad = 0;
+
+	minc_store_dir = (mode >= TABLE_STORE) ? store_dir : NULL;
+	minc_out_of_core = (mode == TABLE_STREAM);
+	if (mode == TABLE_STORE) {
+		// Stored half way first, so that the whole table is then extended from that, and mapped back in after
+		minc_table_free(minc_table_build(tc->coins, tc->n_coins, tc->target / 2, NULL));
+	}
+	if (mode == TABLE_BACKGROUND) {
+		table = minc_table_start(tc->coins, tc->n_coins, tc->target, NULL);
+	} else {
+		table = minc_table_build(tc->coins, tc->n_coins, tc->target, NULL);
+	}
+
+	if (table == NULL) {
+		snprintf(why, why_len, "the table couldn't be built");
+		bad = 1;
+	} else {
+		bad = check_lookups(table, tc, dp, TABLE_CHECKS, why, why_len);
+		minc_table_free(table);
+	}
+	if (!bad && (mode == TABLE_STORE)) {
+		if ((table = minc_table_build(tc->coins, tc->n_coins, tc->target, NULL)) == NULL) {
+			snprintf(why, why_len, "the stored table couldn't be mapped");
+			bad = 1;
+		} else {
+			bad = check_lookups(table, tc, dp, TABLE_CHECKS, why, why_len);
+			minc_table_free(table);
+		}
+	}
+	minc_store_dir = NULL;
+	minc_out_of_core = 0;
+	free(dp);
+	return bad;
+} // check_table
+
+
+// Whether the table store holds a checkpoint of a build that was cut short
+static int
+store_has_part(void)
+{
+	struct dirent *de;
+	int found = 0;
+	DIR *dir;
+
+	if ((dir = opendir(store_dir)) == NULL) {
+		return 0;
+	}
+	while (!found && ((de = readdir(dir)) != NULL)) {
+		found = (strlen(de->d_name) > 5) && !strcmp(de->d_name + strlen(de->d_name) - 5, ".part");
+	}
+	closedir(dir);
+	return found;
+} // store_has_part
+
+
+// Build a table into the store in a child that exits part way, after the build has been checkpointed, and then ask
+// for a far smaller table of the same coins.  That carries on the checkpointed build, which must still come out
+// right all the way to its end, with every coin, and be stored that way.  The largest coin makes for a period past
+// the span, so that the totals after the checkpoint are read as they were built, rather than leapt over.  Returns 0
+// if it agreed with the oracle, or if the build couldn't be cut short, or 1 with a description of the disagreement
+// in why[]
+static int
+check_resume(char *why, size_t why_len)
+{
+	static const testcase_t tc = { 10, { 1, 37, 101, 200, 333, 512, 640, 777, 4999, 65521 }, RESUME_SPAN };
+	minc_result_t result;
+	minc_table_t *table;
+	uint32_t *dp;
+	pid_t pid;
+	int bad;
+
+	minc_store_dir = store_dir;
+	if ((pid = fork()) == 0) {
+		uint64_t start = minc_now_ns();
+
+		// Cut the build short no earlier than half way, and once it's had time to be checkpointed
+		minc_checkpoint_secs = 1;
+		table = minc_table_start(tc.coins, tc.n_coins, tc.target, NULL);
+		while (table && ((minc_table_lookup(table, solver, tc.target / 2, &result, NULL) > 0) ||
+				 (minc_now_ns() - start < RESUME_NS))) {
+			usleep(10000);
+		}
+		_exit(0);
+	}
+	(pid > 0) && waitpid(pid, NULL, 0);
+	if ((pid < 0) || !store_has_part()) {
+		printf("Note: the resumed table wasn't checked, as the build to %u couldn't be cut short\n", tc.target);
+		minc_store_dir = NULL;
+		return 0;
+	}
+
+	dp = oracle_table(&tc);
+	if ((table = minc_table_build(tc.coins, tc.n_coins, 100, NULL)) == NULL) {
+		snprintf(why, why_len, "the checkpointed table couldn't be carried on");
+		bad = 1;
+	} else if (minc_table_resumed(table) == 0) {
+		snprintf(why, why_len, "the table was built afresh rather than carried on from its checkpoint");
+		minc_table_free(table);
+		bad = 1;
+	} else {
+		bad = check_lookups(table, &tc, dp, RESUME_CHECKS, why, why_len);
+		minc_table_free(table);
+	}
+	if (!bad && ((table = minc_table_build(tc.coins, tc.n_coins, 100, NULL)) == NULL)) {
+		snprintf(why, why_len, "the resumed table couldn't be mapped");
+		bad = 1;
+	} else if (!bad) {
+		bad = check_lookups(table, &tc, dp, RESUME_CHECKS, why, why_len);
+		minc_table_free(table);
+	}
+	minc_store_dir = NULL;
+	free(dp);
+	return bad;
+} // check_resume
+
+
+// Empty out the table store and remove it
+static void
+remove_store(void)
+{
+	char path[sizeof(store_dir) + 256];
+	struct dirent *de;
+	DIR *dir;
+
+	if ((dir = opendir(store_dir)) == NULL) {
+		return;
+	}
+	while ((de = readdir(dir)) != NULL) {
+		if (de->d_name[0] != '.') {
+			snprintf(path, sizeof(path), "%s/%s", store_dir, de->d_name);
+			unlink(path);
+		}
+	}
+	closedir(dir);
+	rmdir(store_dir);
+} // remove_store
+
+
+static void
+usage(const char *prog)
+{
+	printf("Usage: %s [-n iterations] [-s seed] [-T max_target] [-e engine] [-t tables] [-v]\n\n", prog);
+	printf("  -n iterations  Number of random cases to run (default: %lu)\n", (unsigned long)opts.iterations);
+	printf("  -s seed        Seed for the case generator (default: %lu)\n", (unsigned long)opts.seed);
+	printf("  -T max_target  Largest target generated (default: %u)\n", opts.max_target);
+	printf("  -e engine      Only test the named engine (default: all)\n");
+	printf("  -t tables      Number of random shared tables to check, built each way in turn (default: %u)\n",
+	       opts.tables);
+	printf("  -v             Print every case as it is run\n");
+} // usage
+
+
+int
+main(int argc, char *argv[])
+{
+	uint64_t state, failures = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:s:T:e:t:vh")) != -1) {
+		switch (opt) {
+		case 'n': opts.iterations = strtoull(optarg, NULL, 10); break;
+		case 's': opts.seed = strtoull(optarg, NULL, 10); break;
+		case 'T': opts.max_target = strtoul(optarg, NULL, 10); break;
+		case 'e': opts.engine = optarg; break;
+		case 't': opts.tables = strtoul(optarg, NULL, 10); break;
+		case 'v': opts.verbose = 1; break;
+		default:
+			usage(argv[0]);
+			return (opt == 'h') ? 0 : 1;
+		}
+	}
+
+	if ((opts.max_target < 1) || (opts.max_target >= UINT32_MAX)) {
+		fprintf(stderr, "Error: max_target must be 1..%u\n", UINT32_MAX - 1);
+		return 1;
+	}
+	if ((opts.engine != NULL) && (minc_find_engine(opts.engine) == NULL)) {
+		fprintf(stderr, "Error: unknown engine '%s'\n", opts.engine);
+		return 1;
+	}
+
+	if ((solver = minc_solver_new()) == NULL) {
+		return 2;
+	}
+
+	for (uint32_t r = 0; r < sizeof(regressions) / sizeof(*regressions); r++) {
+		failures += run_case(&regressions[r], "regression", r);
+	}
+
+	state = opts.seed;
+	for (uint64_t i = 0; i < opts.iterations; i++) {
+		testcase_t tc;
+
+		generate_case(&state, &tc);
+		failures += run_case(&tc, "case", i);
+	}
+
+	if ((opts.tables > 0) && (mkdtemp(store_dir) == NULL)) {
+		fprintf(stderr, "Error: unable to make a table store to test in\n");
+		return 2;
+	}
+	for (uint32_t i = 0; i < opts.tables; i++) {
+		uint32_t mode = i % TABLE_N_MODES;
+		testcase_t tc;
+		char why[256];
+
+		generate_case(&state, &tc);
+		tc.target = (mode == TABLE_STREAM) ? (STREAM_MIN + (tc.target % STREAM_MIN)) : (tc.target % TABLE_MAX);
+		if (opts.verbose) {
+			printf("table %u (%s): ", i, table_modes[mode]);
+			print_case(stdout, &tc);
+			printf("\n");
+		}
+		if (check_table(&tc, mode, why, sizeof(why))) {
+			failures++;
+			printf("FAIL %s table %u: ", table_modes[mode], i);
+			print_case(stdout, &tc);
+			printf("\n  %s\n", why);
+			fflush(stdout);
+		}
+	}
+	if (opts.tables > 0) {
+		char why[256];
+
+		if (check_resume(why, sizeof(why))) {
+			failures++;
+			printf("FAIL resumed table: %s\n", why);
+		}
+		remove_store();
+	}
+
+	printf("%lu cases, %u tables, %lu failures (seed %lu)\n", (unsigned long)opts.iterations, opts.tables,
+	       (unsigned long)failures, (unsigned long)opts.seed);
+	minc_solver_free(solver);
+	return failures ? 1 : 0;
+} // main
@@ -0,0 +1,448 @@
+// Dynamic programming engines
+//
+// Rather than searching outwards from zero, these work through every total in increasing order and take the best of
+// the totals a coin behind.  A total only ever depends on those at most max_coin behind it, so the minimum coin
+// counts are kept in a ring buffer just big enough to hold that window, and only the coin that made each total is
+// written to the full sized table, in order.  Once the tables are far larger than the last-level cache, that turns
+// the breadth-first search's scattered coin-sized strides into sequential streaming
+//
+// A total also depends only on those at least min_coin behind it, so every block of min_coin consecutive totals
+// can be worked on at once given the blocks before it.  When the smallest coin is big enough to be worth it, the
+// wavefront engine splits each block into a slice per thread, and the threads meet at a barrier between blocks
+//
+// Author: Stew Forster (stew675@gmail.com)
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "mincoins_int.h"
+
+// Totals worked on together.  Their counts fit comfortably in L1, along with the window the larger coins read from
+#define TILE_TOTALS	4096U
+
+// Narrowest slice of a block given to a wavefront thread, below which the barriers cost more than they save.  Any
+// block no wider than the smallest coin would give the same answers, since no total in it reads another, so this
+// is a limit on cost alone.  But it can't be lowered far enough to help sets with small coins: a set with a 1 has
+// blocks of a single total, a barrier for each, so those are left to one thread, with a warning if more were asked
+#define WAVE_MIN_SLICE	4096U
+#define WAVE_MAX_THREADS	256U
+
+#define UNREACHED	UINT32_MAX
+
+uint32_t minc_dp_threads = 0;
+static int wave_warned = 0;
+
+// The search state shared by the threads of a wavefront, each of which is given a slice of every block
+typedef struct wave {
+	const uint32_t		*coins;
+	uint32_t		n_coins;
+	uint32_t		span;
+	uint32_t		width;		// Of a block, which is at most the smallest coin
+	uint32_t		mask;
+	uint32_t		*from;
+	uint32_t		*ring;
+	uint32_t		n_threads;
+	pthread_barrier_t	barrier;
+	pthread_mutex_t		gate_lock;
+	pthread_cond_t		gate;
+	int			open;
+} wave_t;
+
+typedef struct wave_worker {
+	pthread_t	tid;
+	wave_t		*wave;
+	uint32_t	index;
+	uint64_t	compares;
+} wave_worker_t;
+
+
+// Offer coin as the last coin for a run of totals, whose counts are at dst[], given the counts a coin behind them at
+// src[].  Branch free, so that the compiler can vectorise it
+static inline void
+relax_run(uint32_t *restrict dst, const uint32_t *restrict src, uint32_t *restrict from, const uint32_t coin,
+	  const uint32_t n)
+{
+	for (uint32_t i = 0; i < n; i++) {
+		uint32_t cand = src[i] + 1;
+		int better = (cand != 0) & (cand < dst[i]);
+
+		dst[i] = better ? cand : dst[i];
+		from[i] = better ? coin : from[i];
+	}
+} // relax_run
+
+
+// Offer coin as the last coin for totals lo up to hi, all of which are at least a coin beyond any total in that
+// range.  The pass is split wherever either end of it wraps around the ring
+static inline void
+relax_ring(uint32_t *ring, const uint32_t mask, uint32_t *from, const uint32_t coin, const uint64_t lo,
+	   const uint64_t hi)
+{
+	for (uint64_t t = lo, run; t < hi; t += run) {
+		uint32_t s = (t - coin) & mask, d = t & mask;
+
+		run = hi - t;
+		(run > (uint64_t)mask + 1 - s) && (run = (uint64_t)mask + 1 - s);
+		(run > (uint64_t)mask + 1 - d) && (run = (uint64_t)mask + 1 - d);
+		relax_run(ring + d, ring + s, from + t, coin, run);
+	}
+} // relax_ring
+
+
+// Fill from[start..span] with the coin that makes each total in the fewest coins, or 0 if it can't be made, given
+// the counts of the totals below start in ring[].  The counts are kept in ring[], which holds at least max_coin +
+// TILE_TOTALS of them, or all span + 1.  If upto isn't NULL, it's set to the last total of each tile as it's
+// finished, for readers of a table still being built.  Like bfs_search() it is always inlined with a constant
+// 'counting'.
+//
+// Coins of at least a tile only reach back into earlier tiles, whose counts are final, so each is applied to the
+// whole tile in one streaming pass.  Smaller coins can reach totals within the tile, so those are finished one
+// total at a time
+static inline __attribute__((always_inline)) void
+tiled_search(const uint32_t coins[], const uint32_t n_coins, const uint32_t start, const uint32_t span, uint32_t *from,
+	     uint32_t *ring, const uint32_t mask, uint32_t *upto, const int counting, minc_stats_t *stats)
+{
+	uint64_t compares = 0;
+	uint32_t n_small;
+
+	for (n_small = 0; (n_small < n_coins) && (coins[n_small] < TILE_TOTALS); n_small++);
+
+	for (uint64_t t0 = start; t0 <= span; t0 += TILE_TOTALS) {
+		uint64_t t1 = ((t0 + TILE_TOTALS) <= ((uint64_t)span + 1)) ? (t0 + TILE_TOTALS) : ((uint64_t)span + 1);
+
+		for (uint64_t t = t0; t < t1; t++) {
+			ring[t & mask] = UNREACHED;
+			from[t] = 0;
+		}
+
+		for (uint32_t c = n_small; (c < n_coins) && (coins[c] < t1); c++) {
+			uint64_t lo = (coins[c] > t0) ? coins[c] : t0;
+
+			relax_ring(ring, mask, from, coins[c], lo, t1);
+			if (counting) {
+				compares += t1 - lo;
+			}
+		}
+
+		for (uint64_t t = t0; (n_small > 0) && (t < t1); t++) {
+			uint32_t best = ring[t & mask], coin = from[t];
+
+			for (uint32_t c = 0; (c < n_small) && (coins[c] <= t); c++) {
+				uint32_t cand = ring[(t - coins[c]) & mask] + 1;
+
+				if (counting) {
+					compares++;
+				}
+				if ((cand != 0) && (cand < best)) {
+					best = cand;
+					coin = coins[c];
+				}
+			}
+			ring[t & mask] = best;
+			from[t] = coin;
+		}
+		if (upto) {
+			__atomic_store_n(upto, t1 - 1, __ATOMIC_RELEASE);
+		}
+	}
+
+	if (counting) {
+		stats->compares += compares;
+	}
+} // tiled_search
+
+
+// Work through this thread's slice of every block, waiting at the end of each block until every slice is done
+static void *
+wave_worker(void *arg)
+{
+	wave_worker_t *w = (wave_worker_t *)arg;
+	wave_t *wave = w->wave;
+
+	pthread_mutex_lock(&wave->gate_lock);
+	while (!wave->open) {
+		pthread_cond_wait(&wave->gate, &wave->gate_lock);
+	}
+	pthread_mutex_unlock(&wave->gate_lock);
+
+	for (uint64_t b0 = 1; b0 <= wave->span; b0 += wave->width) {
+		uint64_t b1 = ((b0 + wave->width) <= ((uint64_t)wave->span + 1)) ? (b0 + wave->width) :
+			      ((uint64_t)wave->span + 1);
+		uint64_t lo = b0 + ((b1 - b0) * w->index) / wave->n_threads;
+		uint64_t hi = b0 + ((b1 - b0) * (w->index + 1)) / wave->n_threads;
+
+		for (uint64_t t = lo; t < hi; t++) {
+			wave->ring[t & wave->mask] = UNREACHED;
+			wave->from[t] = 0;
+		}
+		for (uint32_t c = 0; (c < wave->n_coins) && (wave->coins[c] < hi); c++) {
+			uint64_t start = (wave->coins[c] > lo) ? wave->coins[c] : lo;
+
+			relax_ring(wave->ring, wave->mask, wave->from, wave->coins[c], start, hi);
+			w->compares += hi - start;
+		}
+		pthread_barrier_wait(&wave->barrier);
+	}
+	return NULL;
+} // wave_worker
+
+
+// How many threads to split blocks of the given width over.  Less than 2 means the wavefront isn't worth it
+static uint32_t
+wave_threads(const uint32_t width)
+{
+	uint32_t n_threads = minc_dp_threads;
+
+	if (n_threads == 0) {
+		long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+		n_threads = (n_cpus > 0) ? n_cpus : 1;
+	}
+	(n_threads > WAVE_MAX_THREADS) && (n_threads = WAVE_MAX_THREADS);
+	if (n_threads > width / WAVE_MIN_SLICE) {
+		// Only say so once, and only if the threads were asked for rather than defaulted to
+		if ((minc_dp_threads > 1) && !__atomic_exchange_n(&wave_warned, 1, __ATOMIC_RELAXED)) {
+			fprintf(stderr, "Warning: the wavefront engine uses one thread per %u of the smallest coin, so "
+				"only %u of %u where that's %u\n", WAVE_MIN_SLICE,
+				(width / WAVE_MIN_SLICE > 0) ? width / WAVE_MIN_SLICE : 1, n_threads, width);
+		}
+		n_threads = width / WAVE_MIN_SLICE;
+	}
+	return (n_threads > 0) ? n_threads : 1;
+} // wave_threads
+
+
+// As for tiled_search(), but with every block of width totals split over up to n_threads threads, the caller
+// being the first of them.  If some threads can't be started, the blocks are split over those that were
+static void
+wave_search(const uint32_t coins[], const uint32_t n_coins, const uint32_t span, uint32_t *from, uint32_t *ring,
+	    const uint32_t mask, const uint32_t width, const uint32_t n_threads, minc_stats_t *stats)
+{
+	wave_t wave = { coins, n_coins, span, width, mask, from, ring, n_threads };
+	wave_worker_t workers[WAVE_MAX_THREADS] = {0};
+	uint32_t started;
+
+	// The threads are held at the gate until it's known how many of them there are to share out the slices
+	pthread_mutex_init(&wave.gate_lock, NULL);
+	pthread_cond_init(&wave.gate, NULL);
+
+	for (started = 1; started < n_threads; started++) {
+		workers[started].wave = &wave;
+		workers[started].index = started;
+		if (pthread_create(&workers[started].tid, NULL, wave_worker, &workers[started]) != 0) {
+			break;
+		}
+	}
+
+	pthread_mutex_lock(&wave.gate_lock);
+	wave.n_threads = started;
+	pthread_barrier_init(&wave.barrier, NULL, started);
+	wave.open = 1;
+	pthread_cond_broadcast(&wave.gate);
+	pthread_mutex_unlock(&wave.gate_lock);
+
+	workers[0].wave = &wave;
+	wave_worker(&workers[0]);
+	for (uint32_t t = 1; t < started; t++) {
+		pthread_join(workers[t].tid, NULL);
+	}
+	pthread_barrier_destroy(&wave.barrier);
+	pthread_cond_destroy(&wave.gate);
+	pthread_mutex_destroy(&wave.gate_lock);
+
+	for (uint32_t t = 0; stats && (t < started); t++) {
+		stats->compares += workers[t].compares;
+	}
+} // wave_search
+
+
+// The leap-forward applies here just as it does to the breadth-first search, so only the totals from the leap up
+// to the target are worked through, and held, as offsets from the leap.  With wavefront set the blocks are split over
+// threads, if the smallest coin is wide enough for that to pay
+static int
+dp_solve(minc_solver_t *solver, const uint32_t coins[], uint32_t n_coins, const uint32_t target, minc_result_t *result,
+	 minc_stats_t *stats, const int wavefront)
+{
+	uint64_t faults = stats ? get_minor_faults() : 0;
+	uint32_t leap, n_all, span, max_coin, width, block, n_threads = 1, mask, *totals = NULL, *ring = NULL;
+	uint64_t ring_len = 1;
+	table_t totals_table = {0}, ring_table = {0};
+	phase_mark_t mark;
+	prep_t prep;
+	int ret;
+
+	memset(result, 0, sizeof(*result));
+	result->target = target;
+
+	if ((ret = coins_prepare(&coins, &n_coins, target, &prep, stats)) <= 0) {
+		goto cleanup;
+	}
+	ret = -1;
+	leap = prep.leap;
+	n_all = n_coins;
+	span = prep.target - leap;
+
+	// The table starts at the leap, and every total the reconstruction walks through is written below, so it
+	// needn't start out zeroed
+	totals = solver_table_get(solver, &totals_table, ((size_t)span + 1) * sizeof(*totals), 0);
+	if (totals == NULL) {
+		fprintf(stderr, "Line %d in %s:%s(): Out of memory\n", __LINE__, __FILE__, __func__);
+		goto cleanup;
+	}
+
+	// Coins beyond the span can't be used in it
+	for (; (n_coins > 0) && (coins[n_coins - 1] > span); n_coins--);
+	max_coin = (n_coins > 0) ? coins[n_coins - 1] : 0;
+	width = (n_coins > 0) ? coins[0] : 0;
+	wavefront && (width > 0) && (n_threads = wave_threads(width));
+	block = (n_threads > 1) ? width : TILE_TOTALS;
+
+	// The ring must also hold the block being worked on, without it overwriting the window behind
+	while ((ring_len < (uint64_t)max_coin + block) && (ring_len < (uint64_t)span + 1)) {
+		ring_len <<= 1;
+	}
+	mask = ring_len - 1;
+	if ((ring = solver_table_get(solver, &ring_table, ring_len * sizeof(*ring), 0)) == NULL) {
+		fprintf(stderr, "Line %d in %s:%s(): Out of memory\n", __LINE__, __FILE__, __func__);
+		goto cleanup;
+	}
+
+	// Every search starts from the one total that takes no coins at all
+	ring[0] = 0;
+	phase_begin(stats, &mark);
+	if (n_threads > 1) {
+		wave_search(coins, n_coins, span, totals, ring, mask, width, n_threads, stats);
+	} else if (stats) {
+		tiled_search(coins, n_coins, 1, span, totals, ring, mask, NULL, 1, stats);
+	} else {
+		tiled_search(coins, n_coins, 1, span, totals, ring, mask, NULL, 0, NULL);
+	}
+	phase_end(stats, MINC_PHASE_SEARCH, &mark);
+
+	phase_begin(stats, &mark);
+	if (reconstruct(solver, totals, coins, n_all, span, leap, result) < 0) {
+		goto cleanup;
+	}
+	result_end(result, prep.set->gcd);
+	phase_end(stats, MINC_PHASE_RECONSTRUCT, &mark);
+	ret = 0;
+
+cleanup:
+	coins_release(&prep);
+	solver_table_put(solver, &totals_table, 0, stats);
+	solver_table_put(solver, &ring_table, 0, stats);
+	if (stats) {
+		stats->queries++;
+		stats->pages += get_minor_faults() - faults;
+	}
+	return ret;
+} // dp_solve
+
+
+// Set up the ring for carrying on a table that's complete up to done, out to span.  The counts of the last max_coin
+// totals are recovered by a streaming pass over the table, since each total's count is one more than that of the
+// total its coin was taken from, which is at most max_coin behind.  Returns the ring, or NULL if out of memory
+static uint32_t *
+dp_window(const uint32_t coins[], const uint32_t n_coins, const uint32_t *from, const uint32_t done,
+	  const uint32_t span, table_t *ring_table, uint32_t *mask)
+{
+	uint64_t ring_len = 1;
+	uint32_t *ring;
+
+	while ((ring_len < (uint64_t)coins[n_coins - 1] + TILE_TOTALS) && (ring_len < (uint64_t)span + 1)) {
+		ring_len <<= 1;
+	}
+	*mask = ring_len - 1;
+	if ((ring = table_alloc(ring_table, ring_len * sizeof(*ring))) == NULL) {
+		fprintf(stderr, "Line %d in %s:%s(): Out of memory\n", __LINE__, __FILE__, __func__);
+		return NULL;
+	}
+
+	ring[0] = 0;
+	for (uint64_t t = 1; t <= done; t++) {
+		ring[t & *mask] = from[t] ? (ring[(t - from[t]) & *mask] + 1) : UNREACHED;
+	}
+	return ring;
+} // dp_window
+
+
+// Carry on filling a table that's complete up to done, out to span.  upto is as for tiled_search().  Returns -1 if
+// out of memory
+int
+dp_extend(const uint32_t coins[], const uint32_t n_coins, uint32_t *from, const uint32_t done, const uint32_t span,
+	  uint32_t *upto, minc_stats_t *stats)
+{
+	table_t ring_table;
+	uint32_t mask, *ring;
+
+	if ((ring = dp_window(coins, n_coins, from, done, span, &ring_table, &mask)) == NULL) {
+		return -1;
+	}
+	if (stats) {
+		tiled_search(coins, n_coins, done + 1, span, from, ring, mask, upto, 1, stats);
+	} else {
+		tiled_search(coins, n_coins, done + 1, span, from, ring, mask, upto, 0, NULL);
+	}
+	table_free(&ring_table, stats);
+	return 0;
+} // dp_extend
+
+
+// As for dp_extend(), but for a table far larger than memory.  It's filled a segment of seg_len totals at a time in
+// buf[], and each is handed to sink() to be written out in turn, so that no more than the segment and the ring are
+// ever in memory.  from[] is only read, and only up to done.  Segments start on multiples of seg_len, so the first
+// is given the totals before done + 1 in it from from[].  upto is only set once a segment is written.  Returns -1 if
+// out of memory or if sink() fails
+int
+dp_stream(const uint32_t coins[], const uint32_t n_coins, const uint32_t *from, const uint32_t done,
+	  const uint32_t span, uint32_t *buf, const uint32_t seg_len, dp_sink_fn sink, void *arg, uint32_t *upto,
+	  minc_stats_t *stats)
+{
+	uint64_t first = ((uint64_t)done + 1) - (((uint64_t)done + 1) % seg_len);
+	table_t ring_table;
+	uint32_t mask, *ring;
+	int ret = 0;
+
+	if ((ring = dp_window(coins, n_coins, from, done, span, &ring_table, &mask)) == NULL) {
+		return -1;
+	}
+	memcpy(buf, from + first, ((uint64_t)done + 1 - first) * sizeof(*buf));
+
+	for (uint64_t t0 = done + 1; (ret == 0) && (t0 <= span); first += seg_len, t0 = first) {
+		uint64_t last = ((first + seg_len - 1) < span) ? (first + seg_len - 1) : span;
+
+		// The segment stands in for the table from first on, which is all that the search writes to
+		if (stats) {
+			tiled_search(coins, n_coins, t0, last, buf - first, ring, mask, NULL, 1, stats);
+		} else {
+			tiled_search(coins, n_coins, t0, last, buf - first, ring, mask, NULL, 0, NULL);
+		}
+		if ((ret = sink(arg, first, last - first + 1, buf)) == 0) {
+			__atomic_store_n(upto, last, __ATOMIC_RELEASE);
+		}
+	}
+	table_free(&ring_table, stats);
+	return ret;
+} // dp_stream
+
+
+// Tiled dynamic programming engine
+int
+minc_solve_tiled(minc_solver_t *solver, const uint32_t coins[], uint32_t n_coins, const uint32_t target,
+		 minc_result_t *result, minc_stats_t *stats)
+{
+	return dp_solve(solver, coins, n_coins, target, result, stats, 0);
+} // minc_solve_tiled
+
+
+// Parallel wavefront dynamic programming engine.  Uses minc_dp_threads threads, or one per online CPU if that's 0
+int
+minc_solve_wavefront(minc_solver_t *solver, const uint32_t coins[], uint32_t n_coins, const uint32_t target,
+		     minc_result_t *result, minc_stats_t *stats)
+{
+	return dp_solve(solver, coins, n_coins, target, result, stats, 1);
+} // minc_solve_wavefront
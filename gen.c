@@ -0,0 +1,328 @@
+// Adversarial workload generator for the benchmark suite
+//
+// Writes coin sets and targets that are known to be worst cases for the breadth-first search, in the workload format
+// that minc_bench -W reads.  There is one workload per kind and power of 10 scale:
+//
+//   noleap      Coprime coins large enough that the leap-forward's period, which is at least (max_coin - 1)^2 + 1
+//               and, with every pair of coins coprime, far more than the sum of their pairwise LCMs, lies past
+//               every target, so every search starts from zero and has to cover the whole range
+//   sparse      A large minimum coin, so few totals are reachable.  Unreachable targets are preferred, since the
+//               search has to exhaust every reachable total below them before it can give up
+//   greedyfail  The non-canonical set with the most greedy failures out of many tried, queried only at targets
+//               where greedy gives the wrong answer, so no greedy shortcut could ever answer them
+//
+// Author: Stew Forster (stew675@gmail.com)
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_QUERIES	1024
+#define MAX_COINS	8
+#define UNREACHABLE	UINT32_MAX
+
+typedef struct coinset {
+	uint32_t	n_coins;
+	uint32_t	coins[MAX_COINS];	// In increasing order
+} coinset_t;
+
+static struct {
+	uint64_t	seed;
+	uint32_t	min_exp;
+	uint32_t	max_exp;
+	uint32_t	queries;
+	const char	*kind;
+} opts = { 1, 2, 7, 8, NULL };
+
+
+// Simple LCG so that a seed reproduces the same workloads everywhere
+static uint32_t
+gen_rand(uint64_t *state)
+{
+	*state = (*state * 6364136223846793005ULL) + 1442695040888963407ULL;
+	return (uint32_t)(*state >> 32);
+} // gen_rand
+
+
+static uint32_t
+gcd(uint32_t a, uint32_t b)
+{
+	while (b) {
+		uint32_t rem = a % b;
+
+		a = b;
+		b = rem;
+	}
+	return a;
+} // gcd
+
+
+static int
+is_prime(const uint32_t n)
+{
+	if (n < 2) {
+		return 0;
+	}
+	for (uint32_t d = 2; d * d <= n; d++) {
+		if (n % d == 0) {
+			return 0;
+		}
+	}
+	return 1;
+} // is_prime
+
+
+// Minimum coins for every total up to max_total.  Returns NULL if out of memory
+static uint32_t *
+min_coins_table(const coinset_t *cs, const uint32_t max_total)
+{
+	uint32_t *dp = malloc(((uint64_t)max_total + 1) * sizeof(*dp));
+
+	if (dp == NULL) {
+		fprintf(stderr, "Line %d in %s:%s(): Out of memory\n", __LINE__, __FILE__, __func__);
+		return NULL;
+	}
+
+	dp[0] = 0;
+	for (uint32_t t = 1; t <= max_total; t++) {
+		dp[t] = UNREACHABLE;
+		for (uint32_t c = 0; (c < cs->n_coins) && (cs->coins[c] <= t); c++) {
+			uint32_t prev = dp[t - cs->coins[c]];
+
+			(prev != UNREACHABLE) && (prev + 1 < dp[t]) && (dp[t] = prev + 1);
+		}
+	}
+	return dp;
+} // min_coins_table
+
+
+// Number of coins greedy would use, always taking the largest coin that fits
+static uint32_t
+greedy_coins(const coinset_t *cs, uint32_t total)
+{
+	uint32_t nr = 0;
+
+	for (int c = cs->n_coins - 1; c >= 0; c--) {
+		nr += total / cs->coins[c];
+		total %= cs->coins[c];
+	}
+	return (total == 0) ? nr : UNREACHABLE;
+} // greedy_coins
+
+
+static void
+print_workload(const char *kind, const uint64_t scale, const coinset_t *cs, const uint32_t targets[],
+	       const uint32_t n_targets)
+{
+	printf("%s %lu ", kind, (unsigned long)scale);
+	for (uint32_t c = 0; c < cs->n_coins; c++) {
+		printf("%s%u", c ? "," : "", cs->coins[c]);
+	}
+	printf(" ");
+	for (uint32_t q = 0; q < n_targets; q++) {
+		printf("%s%u", q ? "," : "", targets[q]);
+	}
+	printf("\n");
+} // print_workload
+
+
+// A target somewhere in the top 10% of the scale, as the benchmark's own targets are
+static uint32_t
+near_scale(uint64_t *state, const uint64_t scale)
+{
+	return scale - (gen_rand(state) % ((scale / 10) + 1));
+} // near_scale
+
+
+// A unit coin and three primes in [lo, 1.5 * lo), where lo is past the square root of the largest scale.  The least
+// period that allows is (max_coin - 1)^2 + 1, and the pairwise LCMs with the largest sum to more than lo^2, so
+// neither bound brings the leap within reach of a target
+static void
+gen_noleap(uint64_t *state, const uint64_t max_scale)
+{
+	uint32_t targets[MAX_QUERIES], lo = 2;
+	coinset_t cs = { 1, {1} };
+
+	for (; (uint64_t)(lo - 1) * (lo - 1) <= max_scale; lo *= 2);
+	while (cs.n_coins < 4) {
+		uint32_t p = lo + (gen_rand(state) % (lo / 2)), c = cs.n_coins;
+
+		if (!is_prime(p)) {
+			continue;
+		}
+		// Keep the coins in increasing order, and each prime only once
+		for (; (c > 1) && (cs.coins[c - 1] > p); c--);
+		if (cs.coins[c - 1] != p) {
+			memmove(&cs.coins[c + 1], &cs.coins[c], (cs.n_coins - c) * sizeof(*cs.coins));
+			cs.coins[c] = p;
+			cs.n_coins++;
+		}
+	}
+
+	for (uint64_t scale = 1, x = 0; scale <= max_scale; scale *= 10, x++) {
+		if (x < opts.min_exp) {
+			continue;
+		}
+		for (uint32_t q = 0; q < opts.queries; q++) {
+			targets[q] = near_scale(state, scale);
+		}
+		print_workload("noleap", scale, &cs, targets, opts.queries);
+	}
+} // gen_noleap
+
+
+// Three coins of at least 500, with no common factor so that everything past the Frobenius number is reachable
+static int
+gen_sparse(uint64_t *state, const uint64_t max_scale)
+{
+	uint32_t targets[MAX_QUERIES], *dp;
+	coinset_t cs = { 3, {0} };
+
+	do {
+		cs.coins[0] = 500 + (gen_rand(state) % 500);
+		cs.coins[1] = 1000 + (gen_rand(state) % 1000);
+		cs.coins[2] = 2000 + (gen_rand(state) % 2000);
+	} while (gcd(gcd(cs.coins[0], cs.coins[1]), cs.coins[2]) != 1);
+
+	if ((dp = min_coins_table(&cs, max_scale)) == NULL) {
+		return -1;
+	}
+
+	for (uint64_t scale = 1, x = 0; scale <= max_scale; scale *= 10, x++) {
+		uint32_t n = 0;
+
+		if (x < opts.min_exp) {
+			continue;
+		}
+
+		// Up to half unreachable targets if there are any this high, then fill with whatever comes up
+		for (uint32_t tries = 0; (n < opts.queries / 2) && (tries < 100000); tries++) {
+			uint32_t t = near_scale(state, scale);
+
+			(dp[t] == UNREACHABLE) && (targets[n++] = t);
+		}
+		while (n < opts.queries) {
+			targets[n++] = near_scale(state, scale);
+		}
+		print_workload("sparse", scale, &cs, targets, n);
+	}
+
+	free(dp);
+	return 0;
+} // gen_sparse
+
+
+// Out of many random {1, a, b, c} sets with c <= 100, pick the one that greedy gets wrong most often
+static int
+gen_greedyfail(uint64_t *state, const uint64_t max_scale)
+{
+	uint32_t targets[MAX_QUERIES], best_fails = 0, *dp;
+	coinset_t cs, best = { 0, {0} };
+
+	for (uint32_t attempt = 0; attempt < 200; attempt++) {
+		uint32_t fails = 0, window;
+
+		cs.n_coins = 4;
+		cs.coins[0] = 1;
+		cs.coins[1] = 2 + (gen_rand(state) % 40);
+		cs.coins[2] = cs.coins[1] + 1 + (gen_rand(state) % 40);
+		cs.coins[3] = cs.coins[2] + 1 + (gen_rand(state) % (100 - cs.coins[2]));
+
+		window = 2 * cs.coins[3] * cs.coins[3];
+		if ((dp = min_coins_table(&cs, window)) == NULL) {
+			return -1;
+		}
+		for (uint32_t t = 1; t <= window; t++) {
+			(greedy_coins(&cs, t) > dp[t]) && fails++;
+		}
+		free(dp);
+
+		if (fails > best_fails) {
+			best_fails = fails;
+			best = cs;
+		}
+	}
+
+	if (best_fails == 0) {
+		return 0;
+	}
+	if ((dp = min_coins_table(&best, max_scale)) == NULL) {
+		return -1;
+	}
+
+	for (uint64_t scale = 1, x = 0; scale <= max_scale; scale *= 10, x++) {
+		uint32_t n = 0;
+
+		if (x < opts.min_exp) {
+			continue;
+		}
+		for (uint32_t tries = 0; (n < opts.queries) && (tries < 1000000); tries++) {
+			uint32_t t = near_scale(state, scale);
+
+			(greedy_coins(&best, t) > dp[t]) && (targets[n++] = t);
+		}
+		if (n > 0) {
+			print_workload("greedyfail", scale, &best, targets, n);
+		}
+	}
+
+	free(dp);
+	return 0;
+} // gen_greedyfail
+
+
+static void
+usage(const char *prog)
+{
+	printf("Usage: %s [-s seed] [-n min_exp] [-m max_exp] [-q queries] [-k kind]\n\n", prog);
+	printf("  -s seed     Seed for the generator (default: %lu)\n", (unsigned long)opts.seed);
+	printf("  -n min_exp  Smallest scale as a power of 10 (default: %u)\n", opts.min_exp);
+	printf("  -m max_exp  Largest scale as a power of 10 (default: %u)\n", opts.max_exp);
+	printf("  -q queries  Targets per workload (default: %u)\n", opts.queries);
+	printf("  -k kind     Only generate noleap, sparse or greedyfail workloads (default: all)\n");
+} // usage
+
+
+int
+main(int argc, char *argv[])
+{
+	uint64_t state, max_scale = 1;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "s:n:m:q:k:h")) != -1) {
+		switch (opt) {
+		case 's': opts.seed = strtoull(optarg, NULL, 10); break;
+		case 'n': opts.min_exp = atoi(optarg); break;
+		case 'm': opts.max_exp = atoi(optarg); break;
+		case 'q': opts.queries = atoi(optarg); break;
+		case 'k': opts.kind = optarg; break;
+		default:
+			usage(argv[0]);
+			return (opt == 'h') ? 0 : 1;
+		}
+	}
+
+	if ((opts.max_exp > 9) || (opts.min_exp > opts.max_exp) || (opts.queries < 1) || (opts.queries > MAX_QUERIES)) {
+		fprintf(stderr, "Error: exponents must be ordered and at most 9, and queries must be 1..%d\n", MAX_QUERIES);
+		return 1;
+	}
+	for (uint32_t x = 0; x < opts.max_exp; x++, max_scale *= 10);
+
+	printf("# Adversarial workloads from minc_gen, seed %lu\n", (unsigned long)opts.seed);
+	printf("# name scale coins targets\n");
+
+	state = opts.seed;
+	if ((opts.kind == NULL) || !strcmp(opts.kind, "noleap")) {
+		gen_noleap(&state, max_scale);
+	}
+	if (((opts.kind == NULL) || !strcmp(opts.kind, "sparse")) && (gen_sparse(&state, max_scale) < 0)) {
+		return 1;
+	}
+	if (((opts.kind == NULL) || !strcmp(opts.kind, "greedyfail")) && (gen_greedyfail(&state, max_scale) < 0)) {
+		return 1;
+	}
+
+	return 0;
+} // main
@@ -0,0 +1,115 @@
+// Latency histogram with HDR-style log-linear buckets
+//
+// Values below 2 * MINC_HIST_SUB are counted exactly.  Above that, every power of two is split into MINC_HIST_SUB
+// equal sub-buckets, so any recorded value is reported to within 1 / MINC_HIST_SUB of its true value whatever its
+// magnitude.  Recording is a couple of shifts and an increment, with no locking.  Each thread keeps its own
+// histogram and they are merged by simple addition when a report is wanted
+//
+// Author: Stew Forster (stew675@gmail.com)
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "mincoins.h"
+
+
+static inline uint32_t
+hist_index(const uint64_t val)
+{
+	if (val < (2 * MINC_HIST_SUB)) {
+		return val;
+	}
+
+	uint32_t shift = (63 - __builtin_clzll(val)) - MINC_HIST_SUB_BITS;
+
+	return ((shift + 1) * MINC_HIST_SUB) + ((val >> shift) - MINC_HIST_SUB);
+} // hist_index
+
+
+// The highest value that would be counted in the given bucket
+static inline uint64_t
+hist_value(const uint32_t idx)
+{
+	if (idx < (2 * MINC_HIST_SUB)) {
+		return idx;
+	}
+
+	uint32_t shift = (idx / MINC_HIST_SUB) - 1;
+
+	return ((((uint64_t)(idx % MINC_HIST_SUB) + MINC_HIST_SUB + 1) << shift) - 1);
+} // hist_value
+
+
+void
+minc_hist_init(minc_hist_t *hist)
+{
+	memset(hist, 0, sizeof(*hist));
+	hist->min = UINT64_MAX;
+} // minc_hist_init
+
+
+void
+minc_hist_record(minc_hist_t *hist, const uint64_t val)
+{
+	hist->buckets[hist_index(val)]++;
+	hist->count++;
+	hist->sum += val;
+	(val < hist->min) && (hist->min = val);
+	(val > hist->max) && (hist->max = val);
+} // minc_hist_record
+
+
+void
+minc_hist_merge(minc_hist_t *dst, const minc_hist_t *src)
+{
+	for (uint32_t b = 0; b < MINC_HIST_BUCKETS; b++) {
+		dst->buckets[b] += src->buckets[b];
+	}
+	dst->count += src->count;
+	dst->sum += src->sum;
+	(src->min < dst->min) && (dst->min = src->min);
+	(src->max > dst->max) && (dst->max = src->max);
+} // minc_hist_merge
+
+
+// Returns the value at or below which pct percent of the recorded values lie
+uint64_t
+minc_hist_percentile(const minc_hist_t *hist, const double pct)
+{
+	uint64_t rank, seen = 0;
+
+	if (hist->count == 0) {
+		return 0;
+	}
+
+	rank = (uint64_t)((pct / 100.0) * hist->count + 0.5);
+	(rank < 1) && (rank = 1);
+	(rank > hist->count) && (rank = hist->count);
+
+	for (uint32_t b = 0; b < MINC_HIST_BUCKETS; b++) {
+		if ((seen += hist->buckets[b]) >= rank) {
+			uint64_t val = hist_value(b);
+
+			// Never report beyond what was actually seen
+			return (val > hist->max) ? hist->max : val;
+		}
+	}
+	return hist->max;
+} // minc_hist_percentile
+
+
+// Print the percentile summary on a single line, with values converted from nanoseconds to microseconds
+void
+minc_hist_print(FILE *fp, const minc_hist_t *hist, const char *label)
+{
+	if (hist->count == 0) {
+		fprintf(fp, "%s: no queries recorded\n", label);
+		return;
+	}
+
+	fprintf(fp, "%s: %lu queries, mean %.1f us, p50 %.1f us, p90 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\n",
+		label, (unsigned long)hist->count, (hist->sum / (double)hist->count) / 1e3,
+		minc_hist_percentile(hist, 50.0) / 1e3, minc_hist_percentile(hist, 90.0) / 1e3,
+		minc_hist_percentile(hist, 99.0) / 1e3, minc_hist_percentile(hist, 99.9) / 1e3, hist->max / 1e3);
+} // minc_hist_print
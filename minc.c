@@ -1,8 +1,7 @@
-// Solution to find minimum number of coins of some currency to achieve a target value
+// Determine the least coins to achieve a target value
 //
-// Uses a queue to implement what is essentially a self-pruning breadth-first n-way graph search to find the total
-// Is worst-case O(N * T) where N = number of coins in coin set, and T = total we are looking to minimise for
-// With the implemented pruning, the amortised case is typically much better than O(N * T)
+// Answers a single target given on the command line, or in batch mode a list of targets read from stdin that are
+// shared out over worker threads, or in server mode answers targets one line at a time as they arrive on stdin
 //
 // Author: Stew Forster (stew675@gmail.com)
 // Date: 9th July 2021
@@ -10,191 +9,592 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "mincoins.h"
+
+#define MAX_THREADS	256
+#define MAX_COINS	4096
+
+// The coin set every target is answered for: Australian coin currency unless -C gives another
+static uint32_t coin_set[MAX_COINS] = {1, 2, 5, 10, 20, 50, 100, 200};
+static uint32_t n_coin_set = 8;
+
+static struct {
+	int		stats;
+	int		perf;
+	int		table;
+	uint32_t	range;		// Largest target the server's table is built for
+	int		analyse;
+	uint32_t	threads;
+	uint32_t	cache;		// Most answers to keep in the result cache, or 0 for none
+	const minc_engine_t *engine;	// What targets not answered from the cache or a table are solved with
+} opts = { 0, 0, 0, 1000000, 0, 1, 0, NULL };
+
+// The result cache, shared by every worker, and the analysis of the coin set its answers are keyed by
+static minc_cache_t *cache = NULL;
+static const minc_coinset_t *cache_set = NULL;
+
+typedef struct batch {
+	uint32_t	*targets;
+	minc_result_t	*results;
+	char		*failed;
+	uint32_t	n_targets;
+	uint32_t	next;		// Index of the next target to be claimed by a worker
+	minc_table_t	*table;		// If set, targets are answered from this shared table as it's built
+	struct worker	*workers;
+} batch_t;
+
+// Each worker keeps its own histogram and statistics so that recording never contends
+typedef struct worker {
+	pthread_t	tid;
+	batch_t		*batch;
+	minc_solver_t	*solver;	// Holds the worker's results until they have all been printed
+	minc_stats_t	stats;
+	minc_hist_t	hist;
+} worker_t;
+
+static volatile sig_atomic_t report_requested = 0;
 
-//#define COUNT_COMPARES
 
-#ifdef COUNT_COMPARES
-static uint32_t compares = 0;
-#define INC_COMPARES (compares++)
-#define RESET_COMPARES (compares = 0)
-#define PRINT_COMPARES printf("\nSolution took %u compares\n", compares)
-#else
-#define INC_COMPARES
-#define RESET_COMPARES
-#define PRINT_COMPARES
-#endif
+static void
+usage(const char *prog)
+{
+	printf("Usage: %s [-C coins] [-e engine] [-s] [-p] [-a] [-g mode] [-T trace.json] target\n", prog);
+	printf("       %s [-C coins] [-e engine] [-s] [-p] [-g mode] [-T trace.json] [-c entries]\n", prog);
+	printf("              [-j threads] [-t] [-N mode] [-D dir [-k secs] [-O]] -b  < targets\n");
+	printf("       %s [-C coins] [-e engine] [-s] [-p] [-g mode] [-T trace.json] [-c entries] [-t]\n", prog);
+	printf("              [-R range] [-N mode] [-D dir [-k secs] [-O]] -d\n\n");
+	printf("  -C coins     The coin set in every mode, as a comma separated list (default: the Australian\n");
+	printf("               1,2,5,10,20,50,100,200)\n");
+	printf("  -e engine    Solve targets in every mode with the named engine, as listed by minc_bench -h\n");
+	printf("               (default: auto, which picks one from the coin set's analysis)\n");
+	printf("  -s           Print search statistics and per-phase timings after the result\n");
+	printf("  -p           As for -s, and also count hardware performance events per phase\n");
+	printf("  -a           Print the coin set's analysis: gcd, whether greedy is optimal, Frobenius number, and\n");
+	printf("               the engine the planner picks for the target\n");
+	printf("  -b           Batch mode.  Answer every target read from stdin, one per line, then report\n");
+	printf("               latencies\n");
+	printf("  -j threads   Number of batch worker threads (default: %u)\n", opts.threads);
+	printf("  -c entries   Keep up to this many answers in a result cache, for batch and server modes\n");
+	printf("  -t           Build one table up to the largest batch target, or the range in server mode, and\n");
+	printf("               answer targets from it.  It's built in the background, and targets are searched for\n");
+	printf("               on their own until it has got to them\n");
+	printf("  -R range     Largest target the server's table is built for (default: %u)\n", opts.range);
+	printf("  -N mode      As for -t, placing the table for NUMA with off, interleave or replicate, and pinning\n");
+	printf("               each worker to a node in turn.  Replicas are read by the workers on their own node\n");
+	printf("  -D dir       As for -t, keeping built tables in dir to be mapped by later runs, and extended if\n");
+	printf("               they don't reach far enough\n");
+	printf("  -k secs      Checkpoint a table being built into the store this often, so that a build that's\n");
+	printf("               killed is carried on from there by the next run\n");
+	printf("  -O           Build tables into the store out of core, a segment at a time, as is done anyway for\n");
+	printf("               tables too big for half of memory\n");
+	printf("  -d           Server mode.  Answer each target as it arrives on stdin.  A line of \"stats\" (or\n");
+	printf("               a SIGUSR1) reports the latency percentiles so far\n");
+	printf("  -g mode      Back large search tables with huge pages: off, thp (default) or hugetlb\n");
+	printf("  -T file      Write a Chrome trace-event timeline of phases, BFS levels, queries and flushes\n");
+} // usage
+
+
+// Parse a target, returning 0 if it isn't a positive number that fits in 32 bits
+static uint32_t
+parse_target(const char *str)
+{
+	unsigned long long val;
+	char *end;
 
+	while (isspace((unsigned char)*str)) {
+		str++;
+	}
+	if (!isdigit((unsigned char)*str)) {
+		return 0;
+	}
 
+	errno = 0;
+	val = strtoull(str, &end, 10);
+	while (isspace((unsigned char)*end)) {
+		end++;
+	}
+	if ((errno != 0) || (*end != '\0') || (val >= UINT32_MAX)) {
+		return 0;
+	}
+	return (uint32_t)val;
+} // parse_target
+
+
+// Parse a comma separated list of coins into the coin set.  Returns -1 if it isn't a list of 1 to MAX_COINS
+// positive numbers that fit in 32 bits
 static int
-int32_cmp(const void *a, const void *b)
+parse_coins(const char *str)
 {
-	return *((const int32_t *)a)  - *((const int32_t *)b);
-} // int_cmp
+	uint32_t n = 0;
+	char *end;
 
+	for (const char *pos = str; n < MAX_COINS; pos = end + 1) {
+		unsigned long long val;
 
-// Euclid's algorithm for greatest common divisor of 2 numbers
-static uint32_t
-find_gcd(uint32_t a, uint32_t b)
-{
-	if (a == 0) {
-		return b;
+		errno = 0;
+		val = isdigit((unsigned char)*pos) ? strtoull(pos, &end, 10) : 0;
+		if ((errno != 0) || (val == 0) || (val >= UINT32_MAX) || ((*end != ',') && (*end != '\0'))) {
+			return -1;
+		}
+		coin_set[n++] = (uint32_t)val;
+		if (*end == '\0') {
+			n_coin_set = n;
+			return 0;
+		}
 	}
-	while (b) {
-		uint32_t rem = a % b;
+	return -1;
+} // parse_coins
+
 
-		a = b;
-		b = rem;
+static void
+traced_flush(FILE *fp)
+{
+	uint64_t start = minc_tracing ? minc_now_ns() : 0;
+
+	fflush(fp);
+	if (minc_tracing) {
+		minc_trace_span("flush", "io", start, minc_now_ns(), NULL, 0);
 	}
-	return a;
-} // find_gcd
+} // traced_flush
 
 
-// Find least common multiple of 2 numbers.  Return 0 on a uint32_t overflow
-static uint32_t
-find_lcm(const uint32_t a, const uint32_t b)
+// Answer a target from the result cache if it's there, and otherwise from the table or a search.  If line isn't NULL,
+// it's pointed at the answer's printed line on a cache hit that has one.  Returns 1 if the answer came from the
+// cache, 0 if it had to be worked out, or -1 on error
+static int
+solve_target(const minc_table_t *table, minc_solver_t *solver, const uint32_t target, minc_result_t *result,
+	     const char **line, minc_stats_t *sp, minc_hist_t *hist)
 {
-	if ((a == 0) || (b == 0)) {
-		return 0;
-	}
+	uint64_t start, end;
+	int ret;
 
-	uint64_t lcm = a * b;
+	line && (*line = NULL);
 
-	lcm /= find_gcd(a, b);
+	start = minc_now_ns();
+	if (cache && ((ret = minc_cache_get(cache, cache_set, target, solver, result, line)) != 0)) {
+		sp && (ret > 0) && sp->queries++;
+	} else if (table && (minc_table_lookup(table, solver, target, result, sp) == 0)) {
+		ret = 0;
+	} else {
+		// Until the table has got to the target, or if it's beyond the table, it's searched for on its own
+		ret = opts.engine->solve(solver, coin_set, n_coin_set, target, result, sp);
+	}
+	end = minc_now_ns();
+	minc_hist_record(hist, end - start);
+	if (minc_tracing) {
+		minc_trace_span((ret > 0) ? "cache hit" : "query", "task", start, end, "target", target);
+	}
 
-	return ((lcm > UINT32_MAX) ? 0 : lcm);
-} // find_lcm
+	return ret;
+} // solve_target
 
 
-// Find the least common multiple of all the coins
-static uint32_t
-get_coins_lcm(const uint32_t coins[], const uint32_t n_coins)
+static void *
+batch_worker(void *arg)
 {
-	if (n_coins < 1) {
-		return 0;
+	worker_t *w = (worker_t *)arg;
+	batch_t *batch = w->batch;
+	minc_stats_t *sp = opts.stats ? &w->stats : NULL;
+	uint32_t i, index = w - batch->workers;
+	char name[32];
+
+	snprintf(name, sizeof(name), "worker %u", index);
+	minc_trace_thread_name(name);
+
+	// Deal the workers out over the nodes, so that each reads the replica on its own node
+	if ((minc_numa != MINC_NUMA_OFF) && (minc_numa_pin(index % minc_numa_nodes()) < 0)) {
+		fprintf(stderr, "Warning: unable to pin worker %u to node %u\n", index, index % minc_numa_nodes());
 	}
 
-	uint32_t lcm = coins[0];
-	for (int c = 1; c < n_coins; c++) {
-		lcm = find_lcm(lcm, coins[c]);
+	// Performance counters measure the thread that opened them, so every worker needs its own
+	opts.perf && (w->stats.perf = minc_perf_open());
+
+	while ((i = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED)) < batch->n_targets) {
+		int ret = solve_target(batch->table, w->solver, batch->targets[i], &batch->results[i], NULL, sp,
+				       &w->hist);
+
+		if (ret < 0) {
+			batch->failed[i] = 1;
+		} else if (cache && (ret == 0)) {
+			minc_cache_put(cache, cache_set, &batch->results[i], NULL);
+		}
 	}
-	return lcm;
-} // get_coins_lcm
 
+	minc_perf_close(w->stats.perf);
+	w->stats.perf = NULL;
+	return NULL;
+} // batch_worker
 
-static void
-min_coins_to_total(uint32_t coins[], uint32_t n_coins, const uint32_t target)
+
+// Read every target from stdin, answer them all, then print the answers in input order
+static int
+run_batch(void)
 {
-	// Use calloc 'cos using stack allocation can run us out of stack space easily
-	uint32_t *totals = calloc(target + 1, sizeof(*totals));
-	uint32_t *queue = calloc(target + 1, sizeof(*queue));
-	uint32_t *res = NULL;
+	batch_t batch = {0};
+	worker_t *workers = NULL;
+	uint32_t max_targets = 0;
+	minc_stats_t stats = {0}, table_stats = {0};
+	uint64_t table_start = 0;
+	minc_hist_t hist;
+	char line[256];
+	int ret = 1;
+
+	for (uint32_t lineno = 1; fgets(line, sizeof(line), stdin) != NULL; lineno++) {
+		uint32_t target;
+
+		if ((line[0] == '#') || (strspn(line, " \t\r\n") == strlen(line))) {
+			continue;
+		}
+		if ((target = parse_target(line)) == 0) {
+			fprintf(stderr, "Warning: ignoring invalid target on line %u\n", lineno);
+			continue;
+		}
+		if (batch.n_targets == max_targets) {
+			max_targets = max_targets ? (max_targets * 2) : 1024;
+			if ((batch.targets = realloc(batch.targets, max_targets * sizeof(*batch.targets))) == NULL) {
+				fprintf(stderr, "Line %d in %s:%s(): Out of memory\n", __LINE__, __FILE__, __func__);
+				return 1;
+			}
+		}
+		batch.targets[batch.n_targets++] = target;
+	}
+
+	// The workers start answering while the table is built, rather than waiting on it
+	if (opts.table && (batch.n_targets > 0)) {
+		uint32_t max_target = 0;
+
+		for (uint32_t i = 0; i < batch.n_targets; i++) {
+			(batch.targets[i] > max_target) && (max_target = batch.targets[i]);
+		}
+		table_start = minc_now_ns();
+		if ((batch.table = minc_table_start(coin_set, n_coin_set, max_target,
+						    opts.stats ? &table_stats : NULL)) == NULL) {
+			goto cleanup;
+		}
+	}
 
-	if ((totals == NULL) || (queue == NULL)) {
+	batch.results = calloc(batch.n_targets + 1, sizeof(*batch.results));
+	batch.failed = calloc(batch.n_targets + 1, sizeof(*batch.failed));
+	batch.workers = workers = calloc(opts.threads, sizeof(*workers));
+	if ((batch.results == NULL) || (batch.failed == NULL) || (workers == NULL)) {
 		fprintf(stderr, "Line %d in %s:%s(): Out of memory\n", __LINE__, __FILE__, __func__);
 		goto cleanup;
 	}
 
-	// Sorting the coin set into increasing order allows for search optimisations
-	qsort(coins, n_coins, sizeof(coins[0]), int32_cmp);
+	for (uint32_t t = 0; t < opts.threads; t++) {
+		workers[t].batch = &batch;
+		minc_hist_init(&workers[t].hist);
+		if ((workers[t].solver = minc_solver_new()) == NULL) {
+			opts.threads = t;
+			break;
+		}
+		if (pthread_create(&workers[t].tid, NULL, batch_worker, &workers[t]) != 0) {
+			fprintf(stderr, "Error: unable to start batch worker thread %u\n", t);
+			opts.threads = t;
+			break;
+		}
+	}
 
-	// Minimise the total search space where possible
-	if (target < coins[n_coins - 1]) {
-		// Prune the coin set if larger coins are not needed
-		for (int i = 0; i < n_coins; i++) {
-			if (coins[i] > target) {
-				n_coins = i;
-				break;
-			}
+	minc_hist_init(&hist);
+	for (uint32_t t = 0; t < opts.threads; t++) {
+		pthread_join(workers[t].tid, NULL);
+		minc_hist_merge(&hist, &workers[t].hist);
+		minc_stats_add(&stats, &workers[t].stats);
+	}
+
+	for (uint32_t i = 0; i < batch.n_targets; i++) {
+		if (batch.failed[i]) {
+			printf("%u: error\n", batch.targets[i]);
+		} else {
+			minc_print_result_line(stdout, &batch.results[i], opts.stats ? &stats : NULL);
 		}
-	} else if (n_coins > 2) {
-		uint32_t max_coin = coins[n_coins - 1];
-		uint32_t lcm = get_coins_lcm(coins, n_coins);
+		minc_free_result(&batch.results[i]);
+	}
+	traced_flush(stdout);
 
-		// Leap-forwards in search space as far as practicable
-		if (lcm > 0) {
-			for (uint32_t rt = max_coin; (rt + lcm) <= target; rt += max_coin) {
-				totals[rt] = max_coin;
-				queue[0] = rt;
-			}
+	if (batch.table) {
+		minc_table_wait(batch.table);
+		if (minc_table_resumed(batch.table)) {
+			fprintf(stderr, "Resumed the table build from a checkpoint at %u\n",
+				minc_table_resumed(batch.table));
 		}
+		fprintf(stderr, "Built a table up to %u, ready within %.3f ms\n", minc_table_max(batch.table),
+			(minc_now_ns() - table_start) / 1e6);
+		minc_stats_add(&stats, &table_stats);
+	}
+	minc_hist_print(stderr, &hist, "Batch latency");
+	cache ? minc_cache_print(stderr, cache) : (void)0;
+	if (opts.stats) {
+		minc_print_stats(&stats);
 	}
+	ret = 0;
 
-	RESET_COMPARES;
+cleanup:
+	minc_table_free(batch.table);
+	for (uint32_t t = 0; workers && (t < opts.threads); t++) {
+		minc_solver_free(workers[t].solver);
+	}
+	free(batch.targets);
+	free(batch.results);
+	free(batch.failed);
+	free(workers);
+	return ret;
+} // run_batch
 
-	// Now do the actual search algorithm
-	for (uint32_t queue_pos = 0, queue_max = 1; queue_pos < queue_max; queue_pos++) {
-		for (uint32_t total, qpt = queue[queue_pos], c = 0; c < n_coins; c++) {
-			INC_COMPARES;
-			if ((total = qpt + coins[c]) <= target) {
-				if (totals[total] == 0) {
-					totals[total] = coins[c];
-					queue[queue_max++] = total;
-				}
-				// Short-circuit out of the loops early if we've hit the target
-				(total == target) && (queue_pos = queue_max) && (c = n_coins);
-			} else {
-				break;	// coins are sorted in order, no point in continuing this path
-			}
-		}
+
+static void
+request_report(int sig)
+{
+	report_requested = 1;
+} // request_report
+
+
+// Answer each target as soon as it arrives
+static int
+run_server(void)
+{
+	struct sigaction sa = { .sa_handler = request_report };
+	minc_stats_t stats = {0}, *sp = opts.stats ? &stats : NULL;
+	minc_table_t *table = NULL;
+	minc_solver_t *solver;
+	minc_result_t result;
+	const char *answer;
+	minc_hist_t hist;
+	char line[256];
+	int ret, resume_told = 0;
+
+	if ((solver = minc_solver_new()) == NULL) {
+		return 1;
 	}
 
-	PRINT_COMPARES;
+	// Answering starts at once, with the table taking over targets as it's built
+	if (opts.table && ((table = minc_table_start(coin_set, n_coin_set, opts.range, NULL)) == NULL)) {
+		minc_solver_free(solver);
+		return 1;
+	}
 
-	// Print out the results in summarised sorted order
-	if (totals[target] == 0) {
-		printf("\nNo possible set of coins makes the target of %u\n", target);
-	} else {
-		uint32_t nr = 0, last_coin = 0, last_seq = 0;
+	// No SA_RESTART, so that a report is printed even while we're blocked waiting for input
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGUSR1, &sa, NULL);
+
+	minc_hist_init(&hist);
+	opts.perf && (stats.perf = minc_perf_open());
 
-		for (uint32_t total = target; total > 0; total -= totals[total], nr++);
-		printf("\n%u coins needed to make the target of %u\n\n", nr, target);
+	for (;;) {
+		if (report_requested) {
+			report_requested = 0;
+			minc_hist_print(stderr, &hist, "Latency");
+		}
 
-		if ((res = calloc(nr, sizeof(*res))) != NULL) { 
-			for (uint32_t pos = 0, total = target; total > 0; total -= totals[total], pos++) {
-				res[pos] = totals[total];
+		if (fgets(line, sizeof(line), stdin) == NULL) {
+			if (ferror(stdin) && (errno == EINTR)) {
+				clearerr(stdin);
+				continue;
 			}
+			break;
+		}
 
-			qsort(res, nr, sizeof(res[0]), int32_cmp);
+		line[strcspn(line, "\r\n")] = '\0';
+		if (strcmp(line, "stats") == 0) {
+			minc_hist_print(stdout, &hist, "Latency");
+			cache ? minc_cache_print(stdout, cache) : (void)0;
+			sp ? minc_print_stats(sp) : (void)0;
+			traced_flush(stdout);
+			continue;
+		}
+		if (strcmp(line, "quit") == 0) {
+			break;
+		}
 
-			for (uint32_t pos = 0; pos < nr; pos++) {
-				if ((last_seq > 0) && (res[pos] != last_coin)) {
-					printf("%ux%u + ", last_seq, last_coin);
-					last_seq = 1;
-				} else {
-					last_seq++;
-				}
-				last_coin = res[pos];
+		uint32_t target = parse_target(line);
+
+		if (target == 0) {
+			printf("%s: invalid target\n", line);
+		} else if ((ret = solve_target(table, solver, target, &result, &answer, sp, &hist)) < 0) {
+			printf("%u: error\n", target);
+		} else if (answer) {
+			fputs(answer, stdout);
+		} else if (cache) {
+			// Print the answer to memory first, so the line itself can be cached and sent as is next time
+			char *buf = NULL;
+			size_t len = 0;
+			FILE *mem = open_memstream(&buf, &len);
+
+			mem ? minc_print_result_line(mem, &result, sp) : minc_print_result_line(stdout, &result, sp);
+			if (mem && (fclose(mem) == 0)) {
+				fputs(buf, stdout);
+				minc_cache_put(cache, cache_set, &result, buf);
 			}
-			printf("%ux%u", last_seq, last_coin);
-			printf(" = %u\n", target);
+			free(buf);
+			minc_free_result(&result);
+		} else {
+			minc_print_result_line(stdout, &result, sp);
+			minc_free_result(&result);
+		}
+		traced_flush(stdout);
+		minc_solver_reset(solver);
+
+		// The table is built in the background, so whether it carried on from a checkpoint is only known later
+		if (table && !resume_told && minc_table_resumed(table)) {
+			fprintf(stderr, "Resumed the table build from a checkpoint at %u\n", minc_table_resumed(table));
+			resume_told = 1;
 		}
 	}
 
-cleanup:
-	totals ? free(totals) : 0;
-	queue ? free(queue) : 0;
-	res ? free(res) : 0;
-} // min_coins_to_total
+	minc_hist_print(stderr, &hist, "Latency");
+	minc_perf_close(stats.perf);
+	minc_table_free(table);
+	minc_solver_free(solver);
+	return 0;
+} // run_server
 
 
 int
 main(int argc, char *argv[])
 {
-	uint32_t target, coins[] = {1, 2, 5, 10, 20, 50, 100, 200};	// Australian coin currency
+	uint32_t target;
+	minc_stats_t stats = {0}, *sp = NULL;
+	minc_result_t result;
+	int opt, ret, mode = 0;
+	const char *trace_path = NULL;
+
+	while ((opt = getopt(argc, argv, "C:e:spabdj:c:tR:N:D:k:Og:T:h")) != -1) {
+		switch (opt) {
+		case 'C':
+			if (parse_coins(optarg) < 0) {
+				fprintf(stderr, "Error: coins must be a comma separated list of 1..%d positive "
+					"numbers\n", MAX_COINS);
+				return 1;
+			}
+			break;
+		case 'e':
+			if ((opts.engine = minc_find_engine(optarg)) == NULL) {
+				fprintf(stderr, "Error: unknown engine '%s'\n", optarg);
+				return 1;
+			}
+			break;
+		case 's': opts.stats = 1; break;
+		case 'p': opts.stats = 1; opts.perf = 1; break;
+		case 'a': opts.analyse = 1; break;
+		case 'b': mode = 'b'; break;
+		case 'd': mode = 'd'; break;
+		case 'j': opts.threads = atoi(optarg); break;
+		case 'c': opts.cache = atoi(optarg); break;
+		case 't': opts.table = 1; break;
+		case 'R': opts.range = atoi(optarg); break;
+		case 'N':
+			if (minc_set_numa(optarg) < 0) {
+				fprintf(stderr, "Error: unknown NUMA mode '%s'\n", optarg);
+				return 1;
+			}
+			opts.table = 1;
+			break;
+		case 'D':
+			if (minc_set_store_dir(optarg) < 0) {
+				return 1;
+			}
+			opts.table = 1;
+			break;
+		case 'k': minc_checkpoint_secs = atoi(optarg); break;
+		case 'O': minc_out_of_core = 1; break;
+		case 'T': trace_path = optarg; break;
+		case 'g':
+			if (minc_set_hugepages(optarg) < 0) {
+				fprintf(stderr, "Error: unknown huge page mode '%s'\n", optarg);
+				return 1;
+			}
+			break;
+		default:
+			usage(argv[0]);
+			return (opt == 'h') ? 0 : 1;
+		}
+	}
 
-	if (argc != 2) {
-		printf("Usage: %s target\n", argv[0]);
+	opts.engine || (opts.engine = minc_find_engine("auto"));
+	if (opts.engine->declines && opts.engine->declines(coin_set, n_coin_set)) {
+		fprintf(stderr, "Error: the %s engine declines this coin set\n", opts.engine->name);
 		return 1;
 	}
 
-	target = (uint32_t)atoi(argv[1]);
+	if ((opts.threads < 1) || (opts.threads > MAX_THREADS)) {
+		fprintf(stderr, "Error: threads must be 1..%d\n", MAX_THREADS);
+		return 1;
+	}
+
+	if ((minc_checkpoint_secs || minc_out_of_core) && (minc_store_dir == NULL)) {
+		fprintf(stderr, "Error: checkpoints and out of core builds need a table store (-D dir)\n");
+		return 1;
+	}
+
+	if ((trace_path != NULL) && (minc_trace_open(trace_path) < 0)) {
+		return 1;
+	}
+
+	if (opts.cache && ((mode == 'b') || (mode == 'd'))) {
+		cache_set = minc_coinset_get(coin_set, n_coin_set);
+		if ((cache_set == NULL) || ((cache = minc_cache_new(opts.cache)) == NULL)) {
+			minc_coinset_put(cache_set);
+			return 1;
+		}
+	}
+
+	if ((mode == 'b') || (mode == 'd')) {
+		ret = (mode == 'b') ? run_batch() : run_server();
+		minc_cache_free(cache);
+		minc_coinset_put(cache_set);
+		minc_trace_close();
+		return ret;
+	}
+
+	if (optind != argc - 1) {
+		usage(argv[0]);
+		minc_trace_close();
+		return 1;
+	}
+
+	target = (uint32_t)atoi(argv[optind]);
 
 	if (target < 1) {
 		fprintf(stderr, "Error: target must be a positive number\n");
 		return 1;
 	}
 
-	min_coins_to_total(coins, sizeof(coins) / sizeof(*coins), target);
+	if (opts.stats) {
+		sp = &stats;
+		if (opts.perf && ((stats.perf = minc_perf_open()) == NULL)) {
+			fprintf(stderr, "Warning: hardware performance counters are unavailable\n");
+		}
+	}
+
+	if (opts.engine->solve(NULL, coin_set, n_coin_set, target, &result, sp) < 0) {
+		minc_trace_close();
+		return 1;
+	}
+	minc_print_result(&result, sp);
+	minc_free_result(&result);
+	minc_trace_close();
+
+	if (opts.analyse) {
+		const minc_coinset_t *set = minc_coinset_get(coin_set, n_coin_set);
+
+		if (set) {
+			minc_coinset_print(stdout, set);
+			printf("  planned engine  %s\n", minc_plan(coin_set, n_coin_set, target)->name);
+		}
+		minc_coinset_put(set);
+	}
+
+	if (sp) {
+		minc_print_stats(sp);
+	}
+	minc_perf_close(stats.perf);
 
 	return 0;
 } // main
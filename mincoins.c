@@ -0,0 +1,916 @@
+// Solution to find minimum number of coins of some currency to achieve a target value
+//
+// Uses a queue to implement what is essentially a self-pruning breadth-first n-way graph search to find the total
+// Is worst-case O(N * T) where N = number of coins in coin set, and T = total we are looking to minimise for
+// With the implemented pruning, the amortised case is typically much better than O(N * T)
+//
+// Author: Stew Forster (stew675@gmail.com)
+// Date: 9th July 2021
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/resource.h>
+
+#include "mincoins_int.h"
+
+// The planner hashes a search expected to reach fewer than 1 in PLAN_SPARSE of the totals it covers, and runs one
+// over PLAN_BITSET_COINS or more coins on bitsets
+#define PLAN_SPARSE		64
+#define PLAN_BITSET_COINS	64
+
+
+static const char *phase_names[MINC_N_PHASES] = {
+	"sort", "lcm", "search", "reconstruct", "output"
+};
+
+
+uint64_t
+minc_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+} // minc_now_ns
+
+
+// Minor faults are taken the first time each page of a fresh allocation is touched
+uint64_t
+get_minor_faults(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_THREAD, &ru);
+	return ru.ru_minflt;
+} // get_minor_faults
+
+
+// Coins are unsigned, and subtracting them can overflow an int, so compare rather than subtract
+int
+uint32_cmp(const void *a, const void *b)
+{
+	uint32_t va = *((const uint32_t *)a), vb = *((const uint32_t *)b);
+
+	return (va > vb) - (va < vb);
+} // uint32_cmp
+
+
+// How far a search for target, in units of the gcd, can leap forward.  Every total from the period on is best made
+// using the largest coin, so it can be taken away for as long as what's left is still that large
+static uint32_t
+coins_leap(const minc_coinset_t *set, const uint32_t target)
+{
+	uint32_t max_coin = set->coins[set->n_coins - 1];
+	uint64_t n_leap;
+
+	if ((target < max_coin) || (target < set->period)) {
+		return 0;
+	}
+	n_leap = ((target - set->period) / max_coin) + 1;
+	(n_leap > target / max_coin) && (n_leap = target / max_coin);
+	return n_leap * max_coin;
+} // coins_leap
+
+
+// Fetch the coin set's analysis, and point coins[] at its normalised coins in increasing order, which allows for
+// search optimisations, leaving the caller's own array as it was.  Then minimise the search space where possible.
+// Returns 1 if there's a search to be done, 0 if the target is already known to be out of reach, or -1 if the coin
+// set is unusable.  Unless -1 is returned, the coin set must be released again with coins_release()
+int
+coins_prepare(const uint32_t **coins, uint32_t *n_coins, const uint32_t target, prep_t *prep, minc_stats_t *stats)
+{
+	const minc_coinset_t *set;
+	phase_mark_t mark;
+	uint32_t max_coin;
+
+	memset(prep, 0, sizeof(*prep));
+
+	phase_begin(stats, &mark);
+	if ((set = minc_coinset_get(*coins, *n_coins)) == NULL) {
+		fprintf(stderr, "Error: the coin set has no usable coins\n");
+		return -1;
+	}
+	*coins = set->coins;
+	*n_coins = set->n_coins;
+	prep->set = set;
+	phase_end(stats, MINC_PHASE_SORT, &mark);
+
+	// Only multiples of the gcd can be made, and the residues say whether the rest can without searching
+	if ((target % set->gcd) != 0) {
+		return 0;
+	}
+	prep->target = target / set->gcd;
+	if (set->n_residues && (prep->target < set->residues[prep->target % set->n_residues])) {
+		return 0;
+	}
+
+	phase_begin(stats, &mark);
+	max_coin = set->coins[*n_coins - 1];
+	if (prep->target < max_coin) {
+		// Prune the coin set if larger coins are not needed
+		for (int i = 0; i < *n_coins; i++) {
+			if (set->coins[i] > prep->target) {
+				*n_coins = i;
+				break;
+			}
+		}
+		if (*n_coins == 0) {
+			phase_end(stats, MINC_PHASE_LCM, &mark);
+			return 0;
+		}
+	} else if ((prep->leap = coins_leap(set, prep->target)) > 0) {
+		stats && (stats->leap += (uint64_t)prep->leap * set->gcd);
+	}
+	phase_end(stats, MINC_PHASE_LCM, &mark);
+
+	return 1;
+} // coins_prepare
+
+
+void
+coins_release(prep_t *prep)
+{
+	minc_coinset_put(prep->set);
+	prep->set = NULL;
+} // coins_release
+
+
+// Start a breakdown of the target by coin, with a run for every coin that may be used, all of them empty.  Coins
+// are then counted in with result_add(), which finds their run by a binary search, so the walks back through the
+// tables count each stretch of the same coin in once.  Returns -1 if out of memory
+int
+result_begin(minc_solver_t *solver, minc_result_t *result, const uint32_t coins[], const uint32_t n_coins)
+{
+	if ((result->runs = solver_alloc(solver, n_coins * sizeof(*result->runs))) == NULL) {
+		fprintf(stderr, "Line %d in %s:%s(): Out of memory\n", __LINE__, __FILE__, __func__);
+		return -1;
+	}
+	result->arena = solver;
+	result->n_runs = n_coins;
+	for (uint32_t c = 0; c < n_coins; c++) {
+		result->runs[c].coin = coins[c];
+		result->runs[c].count = 0;
+	}
+	return 0;
+} // result_begin
+
+
+// Finish a breakdown, dropping the coins it doesn't use, and scaling those it does from units of the coin set's gcd
+// back up to the coins actually asked for
+void
+result_end(minc_result_t *result, const uint32_t gcd)
+{
+	uint32_t n_runs = 0;
+
+	result->nr = 0;
+	for (uint32_t r = 0; r < result->n_runs; r++) {
+		if (result->runs[r].count > 0) {
+			result->runs[n_runs].coin = result->runs[r].coin * gcd;
+			result->runs[n_runs++].count = result->runs[r].count;
+			result->nr += result->runs[r].count;
+		}
+	}
+	result->n_runs = n_runs;
+} // result_end
+
+
+// The search loop proper.  It is always inlined with a constant 'counting' so that the compiler emits a separate
+// copy with all of the statistics gathering stripped out for when they aren't wanted.  With 'full' set it doesn't
+// stop on reaching the target, but goes on to find every reachable total up to it, as a shared table needs.  If upto
+// isn't NULL, it's kept up to date with the highest total below which every total is settled, for readers of a table
+// still being built.  Each total is set only once, and atomically, so those readers may also trust any that's set.
+// Returns how many totals went through the queue, as they are exactly the ones that were set
+static inline __attribute__((always_inline)) uint32_t
+bfs_search(const uint32_t coins[], const uint32_t n_coins, const uint32_t target, uint32_t *totals, uint32_t *queue,
+	   const int full, uint32_t *upto, const int counting, minc_stats_t *stats)
+{
+	uint64_t compares = 0, queue_hwm = 0, levels = 0, level_ns = 0;
+	uint32_t queue_pos, queue_max, level_end = 0;
+
+	for (queue_pos = 0, queue_max = 1; queue_pos < queue_max; queue_pos++) {
+		if (counting || upto) {
+			// Every total queued before the current level started is one coin closer to the start
+			if (queue_pos == level_end) {
+				if (counting && minc_tracing) {
+					uint64_t now = minc_now_ns();
+
+					if (levels > 0) {
+						minc_trace_span("bfs level", "search", level_ns, now, "level", levels);
+					}
+					level_ns = now;
+				}
+				levels++;
+				level_end = queue_max;
+
+				// Every total made of fewer coins than this level is set, and none below levels * min_coin
+				// can take more
+				if (upto && (n_coins > 0)) {
+					uint64_t settled = (levels * coins[0]) - 1;
+
+					__atomic_store_n(upto, (settled < target) ? settled : target, __ATOMIC_RELEASE);
+				}
+			}
+			counting && (queue_max - queue_pos > queue_hwm) && (queue_hwm = queue_max - queue_pos);
+		}
+		for (uint32_t total, qpt = queue[queue_pos], c = 0; c < n_coins; c++) {
+			if (counting) {
+				compares++;
+			}
+			if ((total = qpt + coins[c]) <= target) {
+				if (totals[total] == 0) {
+					__atomic_store_n(&totals[total], coins[c], __ATOMIC_RELAXED);
+					queue[queue_max++] = total;
+				}
+				// Short-circuit out of the loops early if we've hit the target
+				!full && (total == target) && (queue_pos = queue_max) && (c = n_coins);
+			} else {
+				break;	// coins are sorted in order, no point in continuing this path
+			}
+		}
+	}
+
+	if (counting) {
+		if (minc_tracing) {
+			minc_trace_span("bfs level", "search", level_ns, minc_now_ns(), "level", levels);
+		}
+		stats->compares += compares;
+		stats->enqueued += queue_max - 1;
+		stats->levels += levels;
+		(queue_hwm > stats->queue_hwm) && (stats->queue_hwm = queue_hwm);
+	}
+	return queue_max;
+} // bfs_search
+
+
+// Recover the coins used to make the target by walking back through the coin that first reached each total.  The
+// totals[] start at the leap, so they only cover the span searched beyond it, and the leap itself is made up of
+// the largest coin, which is counted in all at once.  The walk still takes a step per coin past the leap, as only
+// the last coin of each total is kept, but each stretch of the same coin is counted in with one result_add()
+int
+reconstruct(minc_solver_t *solver, const uint32_t *totals, const uint32_t coins[], const uint32_t n_coins,
+	    const uint32_t span, const uint32_t leap, minc_result_t *result)
+{
+	if (((span > 0) && (totals[span] == 0)) || ((span == 0) && (leap == 0))) {
+		return 0;
+	}
+	if (result_begin(solver, result, coins, n_coins) < 0) {
+		return -1;
+	}
+	for (uint32_t total = span, coin, run; total > 0; result_add(result, coin, run)) {
+		coin = totals[total];
+		for (run = 0; (total > 0) && (totals[total] == coin); total -= coin, run++);
+	}
+	leap && (result->runs[n_coins - 1].count += leap / coins[n_coins - 1]);
+	return 0;
+} // reconstruct
+
+
+// With a solver, the tables are drawn from and returned to its pool, so the entries the query set are cleared again
+// on the way out.  They are exactly the leap-forward totals plus whatever went through the queue, so that costs no
+// more than setting them did
+int
+minc_solve_bfs(minc_solver_t *solver, const uint32_t coins[], uint32_t n_coins, const uint32_t target,
+	       minc_result_t *result, minc_stats_t *stats)
+{
+	uint32_t n_queued = 0, leap;
+	minc_stats_t trace_stats;
+
+	// Tracing needs the instrumented search loop, even if the caller doesn't want the statistics
+	if (minc_tracing && (stats == NULL)) {
+		memset(&trace_stats, 0, sizeof(trace_stats));
+		stats = &trace_stats;
+	}
+
+	uint64_t faults = stats ? get_minor_faults() : 0;
+	table_t totals_table = {0}, queue_table = {0};
+	uint32_t *totals = NULL, *queue = NULL, span;
+	phase_mark_t mark;
+	prep_t prep;
+	int ret = -1, todo;
+
+	memset(result, 0, sizeof(*result));
+	result->target = target;
+
+	// Work in units of the coin set's gcd, so the tables only need to cover the totals that can actually be made
+	if ((todo = coins_prepare(&coins, &n_coins, target, &prep, stats)) <= 0) {
+		ret = todo;
+		goto cleanup;
+	}
+	leap = prep.leap;
+	span = prep.target - leap;
+
+	// Allocate off the stack 'cos using stack allocation can run us out of stack space easily
+	totals = solver_table_get(solver, &totals_table, ((size_t)span + 1) * sizeof(*totals), 1);
+	queue = solver_table_get(solver, &queue_table, ((size_t)span + 1) * sizeof(*queue), 0);
+	if ((totals == NULL) || (queue == NULL)) {
+		fprintf(stderr, "Line %d in %s:%s(): Out of memory\n", __LINE__, __FILE__, __func__);
+		goto cleanup;
+	}
+
+	// The search starts from the leap, which the tables hold as their first total.  A recycled queue holds
+	// whatever the last query left in it
+	queue[0] = 0;
+
+	// Now do the actual search algorithm
+	phase_begin(stats, &mark);
+	if (stats) {
+		n_queued = bfs_search(coins, n_coins, span, totals, queue, 0, NULL, 1, stats);
+	} else {
+		n_queued = bfs_search(coins, n_coins, span, totals, queue, 0, NULL, 0, NULL);
+	}
+	phase_end(stats, MINC_PHASE_SEARCH, &mark);
+
+	// Walk back through the search results to recover the coins used
+	phase_begin(stats, &mark);
+	if (reconstruct(solver, totals, coins, n_coins, span, leap, result) < 0) {
+		goto cleanup;
+	}
+	result_end(result, prep.set->gcd);
+	phase_end(stats, MINC_PHASE_RECONSTRUCT, &mark);
+	ret = 0;
+
+cleanup:
+	coins_release(&prep);
+	if (solver && totals && queue) {
+		for (uint32_t q = 0; q < n_queued; q++) {
+			totals[queue[q]] = 0;
+		}
+	}
+	solver_table_put(solver, &totals_table, 1, stats);
+	solver_table_put(solver, &queue_table, 0, stats);
+	if (stats) {
+		stats->queries++;
+		stats->pages += get_minor_faults() - faults;
+	}
+	return ret;
+} // minc_solve_bfs
+
+
+// Pick the search engine for a query from the coin set's analysis.  The sparse search is for when it's estimated
+// that few of the totals searched can be made at all, the bitset search is for large coin sets, and otherwise it's
+// the breadth-first search
+static const minc_engine_t *
+plan_search(const minc_coinset_t *set, const uint32_t target)
+{
+	const char *name = "bfs";
+
+	if (set && ((target % set->gcd) == 0)) {
+		uint32_t span = (target / set->gcd) - coins_leap(set, target / set->gcd);
+
+		if (coinset_reachable(set, span) * PLAN_SPARSE < (uint64_t)span + 1) {
+			name = "sparse";
+		} else if (set->n_coins >= PLAN_BITSET_COINS) {
+			name = "bitset";
+		}
+	}
+	return minc_find_engine(name);
+} // plan_search
+
+
+// Pick the engine for a query from the coin set's analysis.  Sets with a structure that can be answered in closed
+// form need no search at all, and the rest are searched
+const minc_engine_t *
+minc_plan(const uint32_t coins[], const uint32_t n_coins, const uint32_t target)
+{
+	const minc_coinset_t *set = minc_coinset_get(coins, n_coins);
+	const minc_engine_t *eng;
+
+	eng = (set && (set->family != MINC_FAMILY_NONE)) ? minc_find_engine("closed") : plan_search(set, target);
+	minc_coinset_put(set);
+	return eng;
+} // minc_plan
+
+
+// Whichever engine minc_plan() picks for the query.  Should that one decline the query after all, it's searched for
+int
+minc_solve_auto(minc_solver_t *solver, const uint32_t coins[], uint32_t n_coins, const uint32_t target,
+		minc_result_t *result, minc_stats_t *stats)
+{
+	const minc_engine_t *eng = minc_plan(coins, n_coins, target);
+	const minc_coinset_t *set;
+	int ret;
+
+	if (((ret = eng->solve(solver, coins, n_coins, target, result, stats)) < 0) && eng->declines) {
+		set = minc_coinset_get(coins, n_coins);
+		ret = plan_search(set, target)->solve(solver, coins, n_coins, target, result, stats);
+		minc_coinset_put(set);
+	}
+	return ret;
+} // minc_solve_auto
+
+
+// The original one-shot interface, allocating everything afresh
+int
+min_coins_to_total(const uint32_t coins[], uint32_t n_coins, const uint32_t target, minc_result_t *result,
+		   minc_stats_t *stats)
+{
+	return minc_solve_auto(NULL, coins, n_coins, target, result, stats);
+} // min_coins_to_total
+
+
+struct minc_table {
+	uint32_t		max_total;
+	uint32_t		gcd;				// The table is indexed in units of the coin set's gcd
+	uint32_t		n_copies;
+	table_t			copies[MINC_MAX_NODES];
+	uint32_t		*totals[MINC_MAX_NODES];	// The copy to read from each node
+
+	// How the build is going, for lookups made while it runs in the background
+	const minc_coinset_t	*set;
+	uint32_t		span;
+	uint32_t		n_used;
+	uint32_t		upto;		// Every total up to here, in units of the gcd, is settled
+	uint32_t		resumed;	// Where a checkpointed build was carried on from, in units of the gcd
+	int			by_bfs;		// Beyond upto, any total that's set is settled too
+	int			state;		// TABLE_BUILDING, TABLE_READY or TABLE_FAILED
+	int			background;
+	pthread_t		builder;
+	minc_stats_t		*stats;
+};
+
+enum { TABLE_BUILDING = 0, TABLE_READY, TABLE_FAILED };
+
+
+// Set the span the table is to be built out to, and so which of the coins can be used in building it
+static void
+table_span(minc_table_t *table, const uint32_t span)
+{
+	const minc_coinset_t *set = table->set;
+
+	table->span = span;
+	for (table->n_used = set->n_coins; (table->n_used > 0) && (set->coins[table->n_used - 1] > span); table->n_used--);
+} // table_span
+
+
+// Fill in the table from have on out to its span, with the coin that first reached each total.  A table that's
+// partly built already is carried on with the dynamic programming, which needs no more than the table itself to go
+// on from.  So is a table whose build is being checkpointed, since the dynamic programming settles it from the start
+// on out, where the search only settles it as a whole at the very end.  A table being stored out of core is built
+// by the dynamic programming too, a segment at a time.  Returns -1 if out of memory
+static int
+table_fill(minc_table_t *table, uint32_t *totals, store_t *store)
+{
+	minc_stats_t *stats = table->stats;
+	const uint32_t *coins = table->set->coins;
+	uint32_t have = store ? store->have : 0;
+	table_t queue_table;
+	phase_mark_t mark;
+	uint32_t *queue;
+	int ret = 0;
+
+	phase_begin(stats, &mark);
+	__atomic_store_n(&table->upto, have, __ATOMIC_RELEASE);
+	if (store && store->streaming && (table->n_used > 0)) {
+		ret = store_stream(store, coins, table->n_used, &table->upto, stats);
+	} else if (((have > 0) || (store && store->checkpointing)) && (table->n_used > 0)) {
+		ret = dp_extend(coins, table->n_used, totals, have, table->span, &table->upto, stats);
+	} else if (have == 0) {
+		if ((queue = table_alloc(&queue_table, ((size_t)table->span + 1) * sizeof(*queue))) == NULL) {
+			fprintf(stderr, "Line %d in %s:%s(): Out of memory\n", __LINE__, __FILE__, __func__);
+			return -1;
+		}
+		__atomic_store_n(&table->by_bfs, 1, __ATOMIC_RELAXED);
+		if (stats) {
+			bfs_search(coins, table->n_used, table->span, totals, queue, 1, &table->upto, 1, stats);
+		} else {
+			bfs_search(coins, table->n_used, table->span, totals, queue, 1, &table->upto, 0, NULL);
+		}
+		table_free(&queue_table, stats);
+	}
+	phase_end(stats, MINC_PHASE_SEARCH, &mark);
+	return ret;
+} // table_fill
+
+
+// Build the table, and any replicas of it.  With a table store, a stored table covering the span is mapped rather
+// than built, and may cover more.  Where the table's pages end up is otherwise decided by minc_numa.  Returns -1 if
+// out of memory
+static int
+table_construct(minc_table_t *table)
+{
+	uint32_t *totals = NULL;
+	uint64_t covered;
+	store_t store;
+	size_t size;
+	int node;
+
+	// The first copy is built in place, and any replicas are copied from it afterwards
+	if (minc_store_dir && ((totals = store_open(&store, table->set, table->span, &table->copies[0])) != NULL)) {
+		if (store.building) {
+			// A checkpoint being carried on may be of a build out to further than was asked for
+			table_span(table, store.span);
+			store_checkpoints(&store, &table->upto);
+			__atomic_store_n(&table->resumed, store.resumed, __ATOMIC_RELAXED);
+		}
+		__atomic_store_n(&table->totals[0], totals, __ATOMIC_RELEASE);
+		if (store.building && (table_fill(table, totals, &store) < 0)) {
+			store_abort(&store);
+			totals = NULL;
+		} else if (store.building) {
+			store_publish(&store, &table->copies[0]);
+		}
+	} else {
+		node = (minc_numa == MINC_NUMA_INTERLEAVE) ? TABLE_NODE_INTERLEAVE :
+		       (minc_numa == MINC_NUMA_REPLICATE) ? 0 : TABLE_NODE_LOCAL;
+		totals = table_alloc_node(&table->copies[0], ((size_t)table->span + 1) * sizeof(uint32_t), node);
+		__atomic_store_n(&table->totals[0], totals, __ATOMIC_RELEASE);
+		if (totals && (table_fill(table, totals, NULL) < 0)) {
+			totals = NULL;
+		}
+	}
+	if (totals == NULL) {
+		fprintf(stderr, "Line %d in %s:%s(): Out of memory\n", __LINE__, __FILE__, __func__);
+		return -1;
+	}
+
+	// A stored table may well cover more than was asked for
+	size = table->copies[0].size;
+	covered = ((size / sizeof(uint32_t)) - 1) * table->gcd;
+	if (covered > table->max_total) {
+		__atomic_store_n(&table->max_total, (covered < UINT32_MAX) ? covered : UINT32_MAX - 1, __ATOMIC_RELAXED);
+	}
+
+	for (uint32_t n = 1; n < table->n_copies; n++) {
+		if ((totals = table_alloc_node(&table->copies[n], size, n)) == NULL) {
+			fprintf(stderr, "Line %d in %s:%s(): Out of memory\n", __LINE__, __FILE__, __func__);
+			return -1;
+		}
+		memcpy(totals, table->totals[0], size);
+		__atomic_store_n(&table->totals[n], totals, __ATOMIC_RELEASE);
+	}
+
+	// Without a replica of its own, a node reads the first copy
+	for (uint32_t n = table->n_copies; n < MINC_MAX_NODES; n++) {
+		__atomic_store_n(&table->totals[n], table->totals[0], __ATOMIC_RELEASE);
+	}
+	return 0;
+} // table_construct
+
+
+static void *
+table_builder(void *arg)
+{
+	minc_table_t *table = arg;
+	uint64_t start = minc_now_ns();
+	int state;
+
+	minc_trace_thread_name("table builder");
+	state = (table_construct(table) < 0) ? TABLE_FAILED : TABLE_READY;
+	if (minc_tracing) {
+		minc_trace_span("table build", "task", start, minc_now_ns(), "max", table->max_total);
+	}
+	__atomic_store_n(&table->state, state, __ATOMIC_RELEASE);
+	return NULL;
+} // table_builder
+
+
+// Set up a table for the coin set up to max_total, without building it yet.  Returns NULL if out of memory, or if
+// the coin set has no usable coins
+static minc_table_t *
+table_new(const uint32_t coins[], const uint32_t n_coins, const uint32_t max_total, minc_stats_t *stats)
+{
+	const minc_coinset_t *set;
+	minc_table_t *table;
+	phase_mark_t mark;
+
+	phase_begin(stats, &mark);
+	if ((set = minc_coinset_get(coins, n_coins)) == NULL) {
+		fprintf(stderr, "Error: the coin set has no usable coins\n");
+		return NULL;
+	}
+	if ((table = calloc(1, sizeof(*table))) == NULL) {
+		fprintf(stderr, "Line %d in %s:%s(): Out of memory\n", __LINE__, __FILE__, __func__);
+		minc_coinset_put(set);
+		return NULL;
+	}
+	table->set = set;
+	table->gcd = set->gcd;
+	table->max_total = max_total;
+	table->n_copies = (minc_numa == MINC_NUMA_REPLICATE) ? minc_numa_nodes() : 1;
+	table->stats = stats;
+	table_span(table, max_total / set->gcd);
+	phase_end(stats, MINC_PHASE_SORT, &mark);
+	return table;
+} // table_new
+
+
+// Search out every total up to max_total, and keep the coin that first reached each one.  Only multiples of the coin
+// set's gcd are kept.  Returns NULL if out of memory, or if the coin set has no usable coins
+minc_table_t *
+minc_table_build(const uint32_t coins[], const uint32_t n_coins, const uint32_t max_total, minc_stats_t *stats)
+{
+	minc_table_t *table = table_new(coins, n_coins, max_total, stats);
+
+	if (table && (table_construct(table) < 0)) {
+		minc_table_free(table);
+		return NULL;
+	}
+	table && (table->state = TABLE_READY);
+	return table;
+} // minc_table_build
+
+
+// As for minc_table_build(), but returning at once while the table is built by a thread of its own.  Lookups can be
+// made straight away, and are answered as soon as the part of the table they need is settled.  The statistics are
+// only complete once minc_table_wait() returns
+minc_table_t *
+minc_table_start(const uint32_t coins[], const uint32_t n_coins, const uint32_t max_total, minc_stats_t *stats)
+{
+	minc_table_t *table = table_new(coins, n_coins, max_total, stats);
+
+	if (table && pthread_create(&table->builder, NULL, table_builder, table) != 0) {
+		fprintf(stderr, "Warning: unable to build the table in the background\n");
+		table_builder(table);
+	} else if (table) {
+		table->background = 1;
+	}
+	return table;
+} // minc_table_start
+
+
+// Wait for a table being built in the background to be finished.  Returns -1 if building it failed
+int
+minc_table_wait(minc_table_t *table)
+{
+	if (table->background) {
+		pthread_join(table->builder, NULL);
+		table->background = 0;
+	}
+	return (table->state == TABLE_READY) ? 0 : -1;
+} // minc_table_wait
+
+
+// Walk back from a total beyond what a table still being built by the breadth-first search has settled.  Each
+// total is set only once, to its final value, so if the walk gets all the way back to zero the answer is right.
+// As for reconstruct(), the walk starts past the leap.  Returns 0 if it did, or 1 if it ran into a total that isn't
+// set yet
+static int
+table_walk(minc_solver_t *solver, const uint32_t *totals, const minc_coinset_t *set, const uint32_t target,
+	   const uint32_t leap, minc_result_t *result)
+{
+	uint32_t coin;
+
+	for (uint32_t total = target; total > 0; total -= coin) {
+		if ((coin = __atomic_load_n(&totals[total], __ATOMIC_ACQUIRE)) == 0) {
+			return 1;
+		}
+	}
+
+	if (result_begin(solver, result, set->coins, set->n_coins) < 0) {
+		return -1;
+	}
+	for (uint32_t total = target, run; total > 0; result_add(result, coin, run)) {
+		coin = __atomic_load_n(&totals[total], __ATOMIC_RELAXED);
+		for (run = 0; (total > 0) && (__atomic_load_n(&totals[total], __ATOMIC_RELAXED) == coin); run++) {
+			total -= coin;
+		}
+	}
+	leap && (result->runs[set->n_coins - 1].count += leap / set->coins[set->n_coins - 1]);
+	return 0;
+} // table_walk
+
+
+// Answer a target from a table, reading the copy closest to the calling thread.  Returns 0 if answered, 1 if the
+// table is still being built and hasn't got to the target yet, or -1 if the target is beyond the table, the table
+// couldn't be built, or out of memory
+int
+minc_table_lookup(const minc_table_t *table, minc_solver_t *solver, const uint32_t target, minc_result_t *result,
+		  minc_stats_t *stats)
+{
+	int state = __atomic_load_n(&table->state, __ATOMIC_ACQUIRE);
+	uint32_t t = target / table->gcd, leap, *totals;
+	phase_mark_t mark;
+	int ret;
+
+	memset(result, 0, sizeof(*result));
+	result->target = target;
+	if ((target > __atomic_load_n(&table->max_total, __ATOMIC_RELAXED)) || (state == TABLE_FAILED)) {
+		return -1;
+	}
+	if ((target % table->gcd) != 0) {
+		stats && stats->queries++;
+		return 0;
+	}
+
+	// Far enough out, the table is read as far back as the leap, and the rest is made up of the largest coin
+	phase_begin(stats, &mark);
+	leap = coins_leap(table->set, t);
+	totals = __atomic_load_n(&table->totals[(state == TABLE_READY) ? node_current() : 0], __ATOMIC_ACQUIRE);
+	if ((state == TABLE_READY) || (totals && (t <= __atomic_load_n(&table->upto, __ATOMIC_ACQUIRE)))) {
+		ret = reconstruct(solver, totals, table->set->coins, table->set->n_coins, t - leap, leap, result);
+	} else if (totals && __atomic_load_n(&table->by_bfs, __ATOMIC_RELAXED) && (t <= table->span)) {
+		ret = table_walk(solver, totals, table->set, t - leap, leap, result);
+	} else {
+		ret = 1;
+	}
+	if (ret == 0) {
+		result_end(result, table->gcd);
+	}
+	phase_end(stats, MINC_PHASE_RECONSTRUCT, &mark);
+	stats && (ret == 0) && stats->queries++;
+	return ret;
+} // minc_table_lookup
+
+
+uint32_t
+minc_table_max(const minc_table_t *table)
+{
+	return __atomic_load_n(&table->max_total, __ATOMIC_RELAXED);
+} // minc_table_max
+
+
+// The total a table's build was carried on from, if it resumed a checkpoint from the table store, or 0 if not.  The
+// build sets it as soon as it finds the checkpoint, so it may be asked of a table still being built
+uint32_t
+minc_table_resumed(const minc_table_t *table)
+{
+	return __atomic_load_n(&table->resumed, __ATOMIC_RELAXED) * table->gcd;
+} // minc_table_resumed
+
+
+// A table still being built in the background is waited for first
+void
+minc_table_free(minc_table_t *table)
+{
+	if (table == NULL) {
+		return;
+	}
+	minc_table_wait(table);
+	for (uint32_t n = 0; n < table->n_copies; n++) {
+		table_free(&table->copies[n], NULL);
+	}
+	minc_coinset_put(table->set);
+	free(table);
+} // minc_table_free
+
+
+// Print out the results in summarised sorted order
+void
+minc_print_result(const minc_result_t *result, minc_stats_t *stats)
+{
+	phase_mark_t mark;
+
+	phase_begin(stats, &mark);
+
+	if (result->nr == 0) {
+		printf("\nNo possible set of coins makes the target of %u\n", result->target);
+		phase_end(stats, MINC_PHASE_OUTPUT, &mark);
+		return;
+	}
+
+	printf("\n%u coins needed to make the target of %u\n\n", result->nr, result->target);
+	for (uint32_t r = 0; r < result->n_runs; r++) {
+		printf("%ux%u%s", result->runs[r].count, result->runs[r].coin, (r + 1 < result->n_runs) ? " + " : "");
+	}
+	printf(" = %u\n", result->target);
+	phase_end(stats, MINC_PHASE_OUTPUT, &mark);
+} // minc_print_result
+
+
+// Print out the results on a single line, as used by the batch and server modes
+void
+minc_print_result_line(FILE *fp, const minc_result_t *result, minc_stats_t *stats)
+{
+	phase_mark_t mark;
+
+	phase_begin(stats, &mark);
+	if (result->nr == 0) {
+		fprintf(fp, "%u: no solution\n", result->target);
+		phase_end(stats, MINC_PHASE_OUTPUT, &mark);
+		return;
+	}
+
+	fprintf(fp, "%u: %u coins: ", result->target, result->nr);
+	for (uint32_t r = 0; r < result->n_runs; r++) {
+		fprintf(fp, "%ux%u%s", result->runs[r].count, result->runs[r].coin, (r + 1 < result->n_runs) ? " + " : "\n");
+	}
+	phase_end(stats, MINC_PHASE_OUTPUT, &mark);
+} // minc_print_result_line
+
+
+// Results from a solver's arena are left for minc_solver_reset() to release
+void
+minc_free_result(minc_result_t *result)
+{
+	(result->runs && !result->arena) ? free(result->runs) : 0;
+	result->runs = NULL;
+	result->n_runs = 0;
+	result->nr = 0;
+} // minc_free_result
+
+
+const char *
+minc_phase_name(minc_phase_t phase)
+{
+	return (phase < MINC_N_PHASES) ? phase_names[phase] : "unknown";
+} // minc_phase_name
+
+
+// Accumulate one set of statistics into another.  The queue high-water mark is a maximum, not a sum
+void
+minc_stats_add(minc_stats_t *dst, const minc_stats_t *src)
+{
+	dst->queries += src->queries;
+	dst->compares += src->compares;
+	dst->enqueued += src->enqueued;
+	(src->queue_hwm > dst->queue_hwm) && (dst->queue_hwm = src->queue_hwm);
+	dst->levels += src->levels;
+	dst->leap += src->leap;
+	dst->pages += src->pages;
+	dst->table_bytes += src->table_bytes;
+	dst->huge_bytes += src->huge_bytes;
+	for (int p = 0; p < MINC_N_PHASES; p++) {
+		dst->phase_ns[p] += src->phase_ns[p];
+		for (int e = 0; e < MINC_N_PERF; e++) {
+			dst->perf_counts[p][e] += src->perf_counts[p][e];
+		}
+	}
+	dst->perf_mask |= src->perf_mask;
+} // minc_stats_add
+
+
+void
+minc_print_stats(const minc_stats_t *stats)
+{
+	printf("\nStatistics over %lu quer%s\n", (unsigned long)stats->queries, (stats->queries == 1) ? "y" : "ies");
+	printf("  compares        %lu\n", (unsigned long)stats->compares);
+	printf("  enqueued        %lu\n", (unsigned long)stats->enqueued);
+	printf("  queue hwm       %lu\n", (unsigned long)stats->queue_hwm);
+	printf("  bfs levels      %lu\n", (unsigned long)stats->levels);
+	printf("  leap forward    %lu\n", (unsigned long)stats->leap);
+	printf("  pages touched   %lu\n", (unsigned long)stats->pages);
+	printf("  table resident  %lu KiB\n", (unsigned long)(stats->table_bytes / 1024));
+	printf("  huge pages      %lu KiB (%.1f%%)\n", (unsigned long)(stats->huge_bytes / 1024),
+	       stats->table_bytes ? (100.0 * stats->huge_bytes / stats->table_bytes) : 0.0);
+	for (int p = 0; p < MINC_N_PHASES; p++) {
+		printf("  %-15s %.3f ms\n", phase_names[p], stats->phase_ns[p] / 1e6);
+	}
+
+	if (stats->perf || stats->perf_mask) {
+		printf("\n");
+		minc_print_perf(stats, "  ");
+	}
+} // minc_print_stats
+
+
+// Print the hardware counters of each phase as a table, one row per phase, averaged per query
+void
+minc_print_perf(const minc_stats_t *stats, const char *indent)
+{
+	uint64_t queries = stats->queries ? stats->queries : 1;
+
+	if (stats->perf_mask == 0) {
+		printf("%sHardware performance counters are unavailable\n", indent);
+		return;
+	}
+
+	printf("%s%-12s", indent, "per query");
+	for (int e = 0; e < MINC_N_PERF; e++) {
+		printf(" %14s", minc_perf_name(e));
+	}
+	printf("\n");
+
+	for (int p = 0; p < MINC_N_PHASES; p++) {
+		printf("%s%-12s", indent, phase_names[p]);
+		for (int e = 0; e < MINC_N_PERF; e++) {
+			if (stats->perf_mask & (1U << e)) {
+				printf(" %14.1f", stats->perf_counts[p][e] / (double)queries);
+			} else {
+				printf(" %14s", "n/a");
+			}
+		}
+		printf("\n");
+	}
+} // minc_print_perf
+
+
+// The table of available search engines.  The first entry is the reference engine
+const minc_engine_t minc_engines[] = {
+	{ "bfs", "Self-pruning breadth-first search with leap-forward", minc_solve_bfs },
+	{ "tiled", "Cache-blocked dynamic programming over a sliding window, with leap-forward", minc_solve_tiled },
+	{ "wavefront", "Tiled dynamic programming with blocks of min_coin totals split over threads", minc_solve_wavefront },
+	{ "bitset", "Level-synchronous bitset search for large coin sets, shifting by coin or by total", minc_solve_bitset },
+	{ "sparse", "Breadth-first search over a hash table of the totals reached, for sparsely reachable sets",
+	  minc_solve_sparse },
+	{ "closed", "Greedy and two coin closed forms, or a scan of at most 4096 middle coin counts for three coins",
+	  minc_solve_closed, minc_closed_declines },
+	{ "auto", "Whichever of the above the planner picks from the coin set's analysis", minc_solve_auto },
+};
+const uint32_t minc_n_engines = sizeof(minc_engines) / sizeof(*minc_engines);
+
+
+const minc_engine_t *
+minc_find_engine(const char *name)
+{
+	for (uint32_t e = 0; e < minc_n_engines; e++) {
+		if (strcmp(minc_engines[e].name, name) == 0) {
+			return &minc_engines[e];
+		}
+	}
+	return NULL;
+} // minc_find_engine
@@ -0,0 +1,242 @@
+// Library interface for finding the minimum number of coins of some currency to achieve a target value
+//
+// Author: Stew Forster (stew675@gmail.com)
+// Date: 9th July 2021
+
+#ifndef MINCOINS_H
+#define MINCOINS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Per-thread solver context.  It recycles search tables between queries, and owns an arena that query results are
+// allocated from until the next minc_solver_reset().  See alloc.c
+typedef struct minc_solver minc_solver_t;
+
+// How many of one coin a solution uses
+typedef struct minc_run {
+	uint32_t	coin;
+	uint32_t	count;
+} minc_run_t;
+
+// The outcome of a single query.  A result with nr == 0 means no set of coins can make the target
+typedef struct minc_result {
+	uint32_t	target;
+	uint32_t	nr;		// Number of coins in the solution
+	uint32_t	n_runs;		// Number of different coins in the solution
+	minc_run_t	*runs;		// How many of each coin make up the solution, in increasing order of coin
+	minc_solver_t	*arena;		// If set, runs belongs to this solver's arena rather than the heap
+} minc_result_t;
+
+// Coin set structures that can be answered without a search: in closed form, or by a short bounded scan.  See closed.c
+typedef enum minc_family {
+	MINC_FAMILY_NONE = 0,
+	MINC_FAMILY_GREEDY,	// Canonical, so greedy is optimal, as for geometric and 1-2-5 series
+	MINC_FAMILY_TWO,	// Two coins, solved by extended Euclid
+	MINC_FAMILY_THREE_SCAN	// Three coins, scanning the counts of the middle coin worth trying, of which there are
+				// no more than 4096
+} minc_family_t;
+
+// The analysis of a coin set, shared read-only between every query on it.  See coinset.c
+typedef struct minc_coinset {
+	uint32_t	n_coins;
+	uint32_t	*coins;		// Distinct and non-zero, in increasing order, and divided through by the gcd
+	uint32_t	gcd;		// Every total that can be made is a multiple of this.  The rest is in units of it
+	uint32_t	lcm;		// Or 0 if it overflows 32 bits
+	int		canonical;	// 1 if greedy is always optimal, 0 if not, or -1 if there are too many coins to tell
+	uint64_t	greedy_fail;	// The smallest total greedy doesn't make optimally, if it was looked for
+	int64_t		frobenius;	// The largest total that can't be made, -1 if there are none, or -2 if unknown
+	uint64_t	period;		// Every optimal solution for a total this large or larger uses the largest coin
+	uint64_t	fingerprint;	// Hash of the normalised coins
+	uint32_t	n_residues;	// The smallest coin if the residues are known, or 0 if not
+	uint64_t	*residues;	// The least total that can be made in each class modulo the smallest coin
+	minc_family_t	family;		// Which closed-form solver can answer for the set, if any
+} minc_coinset_t;
+
+// The phases of a query that are individually timed when statistics are enabled
+typedef enum minc_phase {
+	MINC_PHASE_SORT = 0,
+	MINC_PHASE_LCM,
+	MINC_PHASE_SEARCH,
+	MINC_PHASE_RECONSTRUCT,
+	MINC_PHASE_OUTPUT,
+	MINC_N_PHASES
+} minc_phase_t;
+
+// Hardware performance counters that may be read around each phase.  See minc_perf_open()
+typedef enum minc_perf_event {
+	MINC_PERF_CYCLES = 0,
+	MINC_PERF_INSTRUCTIONS,
+	MINC_PERF_BRANCH_MISSES,
+	MINC_PERF_L1D_MISSES,
+	MINC_PERF_LLC_MISSES,
+	MINC_PERF_DTLB_MISSES,
+	MINC_N_PERF
+} minc_perf_event_t;
+
+typedef struct minc_perf minc_perf_t;
+
+// Runtime statistics.  Pass a zeroed minc_stats_t to an engine to collect them, or NULL to run at full speed.
+// Engines add to the counters rather than overwrite them, so one minc_stats_t may accumulate many queries
+typedef struct minc_stats {
+	uint64_t	queries;	// Number of queries accumulated into these stats
+	uint64_t	compares;	// Coin additions tested by the search loop
+	uint64_t	enqueued;	// Totals added to the search queue
+	uint64_t	queue_hwm;	// Most totals waiting in the queue at any one time
+	uint64_t	levels;		// Breadth-first search levels (ie. coins) expanded
+	uint64_t	leap;		// Distance skipped by the leap-forward
+	uint64_t	pages;		// Pages faulted in by the query, ie. touched for the first time
+	uint64_t	table_bytes;	// Resident bytes of the search tables at the end of the query
+	uint64_t	huge_bytes;	// How many of those were on huge pages
+	uint64_t	phase_ns[MINC_N_PHASES];
+
+	// Set perf to the calling thread's counters to also count hardware events per phase
+	minc_perf_t	*perf;
+	uint32_t	perf_mask;	// Which of the perf_counts[][] were actually available
+	uint64_t	perf_counts[MINC_N_PHASES][MINC_N_PERF];
+} minc_stats_t;
+
+// How the large search tables are backed.  See alloc.c
+typedef enum minc_hugepage_mode {
+	MINC_HUGE_OFF = 0,	// Plain calloc(), as small tables always are
+	MINC_HUGE_THP,		// Huge page aligned mappings advised for transparent huge pages
+	MINC_HUGE_HUGETLB	// Explicit hugetlbfs pages, falling back to transparent huge pages if the pool is empty
+} minc_hugepage_mode_t;
+
+// How shared tables are placed on multi-node machines.  See numa.c
+#define MINC_MAX_NODES	64
+
+typedef enum minc_numa_mode {
+	MINC_NUMA_OFF = 0,	// Wherever the building thread's pages land
+	MINC_NUMA_INTERLEAVE,	// Page by page over every node
+	MINC_NUMA_REPLICATE	// A full copy on every node, read by whichever node the reader is running on
+} minc_numa_mode_t;
+
+// A table of the minimum coins solution to every total up to max_total, built once and then shared read-only
+// between any number of threads
+typedef struct minc_table minc_table_t;
+typedef struct minc_cache minc_cache_t;
+
+// Log-linear latency histogram.  See hist.c
+#define MINC_HIST_SUB_BITS	7
+#define MINC_HIST_SUB		(1U << MINC_HIST_SUB_BITS)
+#define MINC_HIST_BUCKETS	((64 - MINC_HIST_SUB_BITS + 1) * MINC_HIST_SUB)
+
+typedef struct minc_hist {
+	uint64_t	count;
+	uint64_t	sum;
+	uint64_t	min;
+	uint64_t	max;
+	uint64_t	buckets[MINC_HIST_BUCKETS];
+} minc_hist_t;
+
+// Every engine solves the same problem, and returns 0 on success, or -1 if it couldn't run (eg. out of memory)
+// Engines leave the coins[] array as it was given.  The solver may be NULL, in which case everything is allocated
+// afresh and the result must be released with minc_free_result()
+typedef int (*minc_solve_fn)(minc_solver_t *solver, const uint32_t coins[], uint32_t n_coins, const uint32_t target,
+			     minc_result_t *result, minc_stats_t *stats);
+
+// An engine that only runs on some coin sets says which ones it declines, returning -1 for them.  Any other engine
+// only returns -1 if it fails
+typedef int (*minc_declines_fn)(const uint32_t coins[], const uint32_t n_coins);
+
+typedef struct minc_engine {
+	const char		*name;
+	const char		*desc;
+	minc_solve_fn		solve;
+	minc_declines_fn	declines;	// Or NULL if it runs on any coin set
+} minc_engine_t;
+
+extern const minc_engine_t minc_engines[];
+extern const uint32_t minc_n_engines;
+
+extern int min_coins_to_total(const uint32_t coins[], uint32_t n_coins, const uint32_t target, minc_result_t *result,
+			      minc_stats_t *stats);
+extern int minc_solve_bfs(minc_solver_t *solver, const uint32_t coins[], uint32_t n_coins, const uint32_t target,
+			  minc_result_t *result, minc_stats_t *stats);
+extern int minc_solve_tiled(minc_solver_t *solver, const uint32_t coins[], uint32_t n_coins, const uint32_t target,
+			    minc_result_t *result, minc_stats_t *stats);
+extern int minc_solve_wavefront(minc_solver_t *solver, const uint32_t coins[], uint32_t n_coins, const uint32_t target,
+				minc_result_t *result, minc_stats_t *stats);
+extern int minc_solve_bitset(minc_solver_t *solver, const uint32_t coins[], uint32_t n_coins, const uint32_t target,
+			     minc_result_t *result, minc_stats_t *stats);
+extern int minc_solve_sparse(minc_solver_t *solver, const uint32_t coins[], uint32_t n_coins, const uint32_t target,
+			     minc_result_t *result, minc_stats_t *stats);
+extern int minc_solve_closed(minc_solver_t *solver, const uint32_t coins[], uint32_t n_coins, const uint32_t target,
+			     minc_result_t *result, minc_stats_t *stats);
+extern int minc_closed_declines(const uint32_t coins[], const uint32_t n_coins);
+extern int minc_solve_auto(minc_solver_t *solver, const uint32_t coins[], uint32_t n_coins, const uint32_t target,
+			   minc_result_t *result, minc_stats_t *stats);
+extern const minc_engine_t *minc_plan(const uint32_t coins[], const uint32_t n_coins, const uint32_t target);
+extern minc_table_t *minc_table_build(const uint32_t coins[], const uint32_t n_coins, const uint32_t max_total,
+				      minc_stats_t *stats);
+extern minc_table_t *minc_table_start(const uint32_t coins[], const uint32_t n_coins, const uint32_t max_total,
+				      minc_stats_t *stats);
+extern int minc_table_wait(minc_table_t *table);
+extern int minc_table_lookup(const minc_table_t *table, minc_solver_t *solver, const uint32_t target,
+			     minc_result_t *result, minc_stats_t *stats);
+extern uint32_t minc_table_max(const minc_table_t *table);
+extern uint32_t minc_table_resumed(const minc_table_t *table);
+extern void minc_table_free(minc_table_t *table);
+extern const minc_engine_t *minc_find_engine(const char *name);
+extern void minc_print_result(const minc_result_t *result, minc_stats_t *stats);
+extern void minc_print_result_line(FILE *fp, const minc_result_t *result, minc_stats_t *stats);
+extern void minc_free_result(minc_result_t *result);
+
+extern uint64_t minc_now_ns(void);
+extern const char *minc_phase_name(minc_phase_t phase);
+extern void minc_stats_add(minc_stats_t *dst, const minc_stats_t *src);
+extern void minc_print_stats(const minc_stats_t *stats);
+extern void minc_print_perf(const minc_stats_t *stats, const char *indent);
+
+extern void minc_hist_init(minc_hist_t *hist);
+extern void minc_hist_record(minc_hist_t *hist, const uint64_t val);
+extern void minc_hist_merge(minc_hist_t *dst, const minc_hist_t *src);
+extern uint64_t minc_hist_percentile(const minc_hist_t *hist, const double pct);
+extern void minc_hist_print(FILE *fp, const minc_hist_t *hist, const char *label);
+
+extern int minc_tracing;
+extern int minc_trace_open(const char *path);
+extern void minc_trace_close(void);
+extern void minc_trace_thread_name(const char *name);
+extern void minc_trace_span(const char *name, const char *cat, uint64_t start_ns, uint64_t end_ns,
+			    const char *arg_name, uint64_t arg_val);
+
+extern const minc_coinset_t *minc_coinset_get(const uint32_t coins[], const uint32_t n_coins);
+extern void minc_coinset_put(const minc_coinset_t *set);
+extern void minc_coinset_print(FILE *fp, const minc_coinset_t *set);
+
+extern minc_cache_t *minc_cache_new(const uint32_t max_entries);
+extern void minc_cache_free(minc_cache_t *cache);
+extern int minc_cache_get(minc_cache_t *cache, const minc_coinset_t *set, const uint32_t target, minc_solver_t *solver,
+			  minc_result_t *result, const char **line);
+extern void minc_cache_put(minc_cache_t *cache, const minc_coinset_t *set, const minc_result_t *result,
+			   const char *line);
+extern void minc_cache_print(FILE *fp, minc_cache_t *cache);
+
+extern minc_solver_t *minc_solver_new(void);
+extern void minc_solver_reset(minc_solver_t *solver);
+extern void minc_solver_free(minc_solver_t *solver);
+
+extern uint32_t minc_dp_threads;
+
+extern int minc_hugepages;
+extern int minc_set_hugepages(const char *name);
+
+extern const char *minc_store_dir;
+extern int minc_set_store_dir(const char *path);
+extern uint32_t minc_checkpoint_secs;
+extern int minc_out_of_core;
+
+extern int minc_numa;
+extern int minc_set_numa(const char *name);
+extern uint32_t minc_numa_nodes(void);
+extern int minc_numa_pin(const uint32_t node);
+
+extern minc_perf_t *minc_perf_open(void);
+extern void minc_perf_close(minc_perf_t *perf);
+extern uint32_t minc_perf_mask(const minc_perf_t *perf);
+extern void minc_perf_read(const minc_perf_t *perf, uint64_t counts[MINC_N_PERF]);
+extern const char *minc_perf_name(minc_perf_event_t event);
+
+#endif // MINCOINS_H
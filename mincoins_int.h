@@ -0,0 +1,157 @@
+// Helpers shared between the modules of the minimum coins library.  Not part of the public interface
+//
+// Author: Stew Forster (stew675@gmail.com)
+
+#ifndef MINCOINS_INT_H
+#define MINCOINS_INT_H
+
+#include <limits.h>
+#include <pthread.h>
+
+#include "mincoins.h"
+
+// Where a timed phase started, in time and, if enabled, hardware counters
+typedef struct phase_mark {
+	uint64_t	ns;
+	uint64_t	perf[MINC_N_PERF];
+} phase_mark_t;
+
+
+// Phase timing costs nothing beyond a couple of tests when neither statistics nor tracing are enabled
+static inline void
+phase_begin(const minc_stats_t *stats, phase_mark_t *mark)
+{
+	if (stats || minc_tracing) {
+		(stats && stats->perf) ? minc_perf_read(stats->perf, mark->perf) : (void)0;
+		mark->ns = minc_now_ns();
+	}
+} // phase_begin
+
+
+static inline void
+phase_end(minc_stats_t *stats, const minc_phase_t phase, const phase_mark_t *mark)
+{
+	if (minc_tracing) {
+		minc_trace_span(minc_phase_name(phase), "phase", mark->ns, minc_now_ns(), NULL, 0);
+	}
+	if (stats) {
+		stats->phase_ns[phase] += minc_now_ns() - mark->ns;
+		if (stats->perf) {
+			uint64_t now[MINC_N_PERF];
+
+			minc_perf_read(stats->perf, now);
+			for (int e = 0; e < MINC_N_PERF; e++) {
+				stats->perf_counts[phase][e] += now[e] - mark->perf[e];
+			}
+			stats->perf_mask |= minc_perf_mask(stats->perf);
+		}
+	}
+} // phase_end
+
+
+// A large zeroed table, from the heap or mapped directly so that it can be backed by huge pages.  See alloc.c
+typedef enum table_kind {
+	TABLE_HEAP = 0,
+	TABLE_MMAP,
+	TABLE_HUGETLB,
+	TABLE_FILE			// Mapped from the table store
+} table_kind_t;
+
+typedef struct table {
+	void		*base;
+	size_t		size;		// Bytes asked for
+	void		*map;		// The whole mapping, including any guard pages, if not from the heap
+	size_t		map_len;
+	table_kind_t	kind;
+} table_t;
+
+extern uint64_t get_minor_faults(void);
+extern int uint32_cmp(const void *a, const void *b);
+
+// A coin set made ready for one query.  See coins_prepare()
+typedef struct prep {
+	const minc_coinset_t	*set;
+	uint32_t		target;		// In units of the coin set's gcd
+	uint32_t		leap;		// How far the search can leap forward, as a multiple of the largest coin
+} prep_t;
+
+extern uint64_t find_gcd(uint64_t a, uint64_t b);
+extern uint64_t coinset_reachable(const minc_coinset_t *set, const uint32_t span);
+extern int coins_prepare(const uint32_t **coins, uint32_t *n_coins, const uint32_t target, prep_t *prep,
+			 minc_stats_t *stats);
+extern void coins_release(prep_t *prep);
+extern int result_begin(minc_solver_t *solver, minc_result_t *result, const uint32_t coins[], const uint32_t n_coins);
+extern void result_end(minc_result_t *result, const uint32_t gcd);
+extern int reconstruct(minc_solver_t *solver, const uint32_t *totals, const uint32_t coins[], const uint32_t n_coins,
+		       const uint32_t span, const uint32_t leap, minc_result_t *result);
+
+// Count a coin into a breakdown started with result_begin(), where the runs are still one per coin of the set
+static inline void
+result_add(minc_result_t *result, const uint32_t coin, const uint32_t count)
+{
+	uint32_t lo = 0, hi = result->n_runs - 1;
+
+	while (lo < hi) {
+		uint32_t mid = (lo + hi) / 2;
+
+		(result->runs[mid].coin < coin) ? (lo = mid + 1) : (hi = mid);
+	}
+	result->runs[lo].count += count;
+} // result_add
+
+extern void *solver_alloc(minc_solver_t *solver, size_t size);
+extern void *solver_table_get(minc_solver_t *solver, table_t *table, const size_t size, const int zeroed);
+extern void solver_table_put(minc_solver_t *solver, table_t *table, const int clean, minc_stats_t *stats);
+
+#define TABLE_NODE_LOCAL	(-1)
+#define TABLE_NODE_INTERLEAVE	(-2)
+
+extern void *table_alloc(table_t *table, const size_t size);
+extern void *table_alloc_node(table_t *table, const size_t size, const int node);
+extern void table_free(table_t *table, minc_stats_t *stats);
+
+// A table being built for the on-disk store.  See store.c
+typedef struct store {
+	char		path[PATH_MAX];
+	char		tmp[PATH_MAX];
+	int		lock_fd;
+	int		building;
+	uint32_t	span;		// How far the table is to be built, which may be further than was asked for
+	uint32_t	have;		// How far the table was already built, or 0 if it's to be built from scratch
+	uint32_t	resumed;	// How far the checkpoint being carried on got, or 0 if there isn't one
+	table_t		*table;
+
+	// Out-of-core building, where the table is written out a segment at a time rather than through the mapping
+	int		streaming;
+	int		fd;
+	int		direct_fd;	// Or -1 if the file system doesn't take direct I/O
+
+	// Checkpointing of the build, if it's enabled
+	int		checkpointing;
+	int		stop;
+	uint32_t	*upto;		// How far the table is settled
+	pthread_t	checkpointer;
+	pthread_mutex_t	lock;
+	pthread_cond_t	wake;
+} store_t;
+
+extern uint32_t *store_open(store_t *store, const minc_coinset_t *set, const uint32_t span, table_t *table);
+extern void store_checkpoints(store_t *store, uint32_t *upto);
+extern int store_stream(store_t *store, const uint32_t coins[], const uint32_t n_coins, uint32_t *upto,
+			minc_stats_t *stats);
+extern int store_publish(store_t *store, table_t *table);
+extern void store_abort(store_t *store);
+
+// Writes out the n totals of a table from first on, returning -1 if that fails.  See dp_stream()
+typedef int (*dp_sink_fn)(void *arg, const uint64_t first, const uint32_t n, const uint32_t *buf);
+
+extern int dp_extend(const uint32_t coins[], const uint32_t n_coins, uint32_t *from, const uint32_t done,
+		     const uint32_t span, uint32_t *upto, minc_stats_t *stats);
+extern int dp_stream(const uint32_t coins[], const uint32_t n_coins, const uint32_t *from, const uint32_t done,
+		     const uint32_t span, uint32_t *buf, const uint32_t seg_len, dp_sink_fn sink, void *arg,
+		     uint32_t *upto, minc_stats_t *stats);
+
+extern uint32_t node_current(void);
+extern int node_bind(void *addr, const size_t len, const int node);
+
+#endif // MINCOINS_INT_H
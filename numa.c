@@ -0,0 +1,144 @@
+// NUMA placement of shared tables, and binding of threads to nodes
+//
+// A table is built once and then read by every batch worker, so on a multi-socket machine the workers on the far
+// socket pay remote memory latency on every lookup.  It can instead be interleaved page by page over all nodes, so
+// that every worker sees the same average latency, or replicated with one copy per node, so that every worker
+// reads locally once it has been pinned to a node.  This talks to the kernel directly, rather than through
+// libnuma, so there's nothing extra to link against
+//
+// Author: Stew Forster (stew675@gmail.com)
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+#include "mincoins_int.h"
+
+#define BITS_PER_LONG	(8 * sizeof(unsigned long))
+
+int minc_numa = MINC_NUMA_OFF;
+
+static const char *numa_names[] = { "off", "interleave", "replicate" };
+static uint32_t n_nodes = 0;
+static __thread int pinned_node = -1;
+
+
+// Select how shared tables are placed by name.  Returns -1 if the name isn't known
+int
+minc_set_numa(const char *name)
+{
+	for (int m = MINC_NUMA_OFF; m <= MINC_NUMA_REPLICATE; m++) {
+		if (strcmp(name, numa_names[m]) == 0) {
+			minc_numa = m;
+			return 0;
+		}
+	}
+	return -1;
+} // minc_set_numa
+
+
+// Parse a kernel CPU or node list, such as "0-3,8-11", into a bitmask.  Returns the highest entry plus one
+static uint32_t
+parse_list(const char *path, unsigned long *mask, const uint32_t max_bits)
+{
+	uint32_t lo, hi, top = 0;
+	char buf[1024], *p = buf;
+	FILE *fp;
+
+	if ((fp = fopen(path, "r")) == NULL) {
+		return 0;
+	}
+	buf[0] = '\0';
+	p = fgets(buf, sizeof(buf), fp);
+	fclose(fp);
+	if (p == NULL) {
+		return 0;
+	}
+
+	while (sscanf(p, "%u", &lo) == 1) {
+		hi = lo;
+		for (; (*p >= '0') && (*p <= '9'); p++);
+		if (*p == '-') {
+			hi = strtoul(++p, &p, 10);
+		}
+		for (uint32_t b = lo; (b <= hi) && (b < max_bits); b++) {
+			mask && (mask[b / BITS_PER_LONG] |= 1UL << (b % BITS_PER_LONG));
+			top = b + 1;
+		}
+		if (*p++ != ',') {
+			break;
+		}
+	}
+	return top;
+} // parse_list
+
+
+// Number of NUMA nodes, counting from node 0 to the highest online one.  Machines without NUMA have just the one
+uint32_t
+minc_numa_nodes(void)
+{
+	if (n_nodes == 0) {
+		n_nodes = parse_list("/sys/devices/system/node/online", NULL, MINC_MAX_NODES);
+		(n_nodes == 0) && (n_nodes = 1);
+	}
+	return n_nodes;
+} // minc_numa_nodes
+
+
+// Bind the calling thread to the CPUs of a node.  Returns -1 if that isn't possible
+int
+minc_numa_pin(const uint32_t node)
+{
+	char path[64];
+	cpu_set_t cpus;
+
+	CPU_ZERO(&cpus);
+	snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", node);
+	if ((parse_list(path, (unsigned long *)&cpus, CPU_SETSIZE) == 0) ||
+	    (sched_setaffinity(0, sizeof(cpus), &cpus) < 0)) {
+		return -1;
+	}
+	pinned_node = node;
+	return 0;
+} // minc_numa_pin
+
+
+// The node the calling thread runs on.  Cheap once the thread has been pinned
+uint32_t
+node_current(void)
+{
+	unsigned int cpu, node = 0;
+
+	if (pinned_node >= 0) {
+		return pinned_node;
+	}
+	getcpu(&cpu, &node);
+	return (node < MINC_MAX_NODES) ? node : 0;
+} // node_current
+
+
+// Set the memory policy of a range that hasn't been touched yet.  TABLE_NODE_INTERLEAVE spreads it over every node
+int
+node_bind(void *addr, const size_t len, const int node)
+{
+	unsigned long mask[(MINC_MAX_NODES + BITS_PER_LONG - 1) / BITS_PER_LONG] = {0};
+	int mode = MPOL_BIND;
+
+	if (node == TABLE_NODE_INTERLEAVE) {
+		for (uint32_t n = 0; n < minc_numa_nodes(); n++) {
+			mask[n / BITS_PER_LONG] |= 1UL << (n % BITS_PER_LONG);
+		}
+		mode = MPOL_INTERLEAVE;
+	} else {
+		mask[node / BITS_PER_LONG] |= 1UL << (node % BITS_PER_LONG);
+	}
+
+	// The kernel's maxnode is one more than the number of bits it actually reads
+	return syscall(SYS_mbind, addr, len, mode, mask, MINC_MAX_NODES + 1, 0) ? -1 : 0;
+} // node_bind
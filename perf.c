@@ -0,0 +1,122 @@
+// Optional Linux hardware performance counters, read around each phase of a query
+//
+// Each counter is opened as its own event rather than as a group, so that a PMU with too few counters to hold them
+// all at once multiplexes them instead of refusing to schedule any.  Readings are scaled for the time each counter
+// was actually running.  Counters that the kernel or hardware can't provide are simply left unavailable
+//
+// Author: Stew Forster (stew675@gmail.com)
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "mincoins.h"
+
+struct minc_perf {
+	int	fd[MINC_N_PERF];
+};
+
+#define CACHE_MISS(cache)	((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static const struct {
+	const char	*name;
+	uint32_t	type;
+	uint64_t	config;
+} perf_events[MINC_N_PERF] = {
+	{ "cycles",		PERF_TYPE_HARDWARE,	PERF_COUNT_HW_CPU_CYCLES },
+	{ "instructions",	PERF_TYPE_HARDWARE,	PERF_COUNT_HW_INSTRUCTIONS },
+	{ "branch-misses",	PERF_TYPE_HARDWARE,	PERF_COUNT_HW_BRANCH_MISSES },
+	{ "L1d-misses",		PERF_TYPE_HW_CACHE,	CACHE_MISS(PERF_COUNT_HW_CACHE_L1D) },
+	{ "LLC-misses",		PERF_TYPE_HARDWARE,	PERF_COUNT_HW_CACHE_MISSES },
+	{ "dTLB-misses",	PERF_TYPE_HW_CACHE,	CACHE_MISS(PERF_COUNT_HW_CACHE_DTLB) },
+};
+
+
+const char *
+minc_perf_name(minc_perf_event_t event)
+{
+	return (event < MINC_N_PERF) ? perf_events[event].name : "unknown";
+} // minc_perf_name
+
+
+// Open counters for the calling thread.  Returns NULL if not a single counter could be opened
+minc_perf_t *
+minc_perf_open(void)
+{
+	minc_perf_t *perf = calloc(1, sizeof(*perf));
+	int n_open = 0;
+
+	if (perf == NULL) {
+		return NULL;
+	}
+
+	for (int e = 0; e < MINC_N_PERF; e++) {
+		struct perf_event_attr attr;
+
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = perf_events[e].type;
+		attr.config = perf_events[e].config;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		attr.exclude_kernel = 1;	// Allowed at the default perf_event_paranoid level
+		attr.exclude_hv = 1;
+
+		perf->fd[e] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+		(perf->fd[e] >= 0) && n_open++;
+	}
+
+	if (n_open == 0) {
+		free(perf);
+		return NULL;
+	}
+	return perf;
+} // minc_perf_open
+
+
+void
+minc_perf_close(minc_perf_t *perf)
+{
+	if (perf == NULL) {
+		return;
+	}
+	for (int e = 0; e < MINC_N_PERF; e++) {
+		(perf->fd[e] >= 0) && close(perf->fd[e]);
+	}
+	free(perf);
+} // minc_perf_close
+
+
+// Returns a bitmask of the counters that are actually available
+uint32_t
+minc_perf_mask(const minc_perf_t *perf)
+{
+	uint32_t mask = 0;
+
+	for (int e = 0; (perf != NULL) && (e < MINC_N_PERF); e++) {
+		(perf->fd[e] >= 0) && (mask |= (1U << e));
+	}
+	return mask;
+} // minc_perf_mask
+
+
+// Read the current value of every counter, scaled up for any time spent multiplexed out
+void
+minc_perf_read(const minc_perf_t *perf, uint64_t counts[MINC_N_PERF])
+{
+	for (int e = 0; e < MINC_N_PERF; e++) {
+		uint64_t val[3];	// value, time enabled, time running
+
+		counts[e] = 0;
+		if ((perf->fd[e] < 0) || (read(perf->fd[e], val, sizeof(val)) != sizeof(val))) {
+			continue;
+		}
+		if ((val[2] > 0) && (val[2] < val[1])) {
+			val[0] = (uint64_t)((double)val[0] * ((double)val[1] / (double)val[2]));
+		}
+		counts[e] = val[0];
+	}
+} // minc_perf_read
@@ -0,0 +1,257 @@
+// Sparse breadth-first search engine
+//
+// When the smallest coin is large and the coins have few small combinations, only a small fraction of the totals
+// up to the target can be made at all, and the dense tables of the other engines are almost all zeros.  This engine
+// runs the same self-pruning breadth-first search, but keeps the coin that first reached each total in an
+// open-addressing hash table keyed by the total, so that memory goes with the totals actually reached rather than
+// with the target.  Each slot holds a total and its coin side by side, so that a probe reads a single cache line,
+// and linear probing keeps most collisions within it
+//
+// As for the other engines, the hash table and queue come from the solver's pool.  The slots a query used are
+// cleared again on the way out, so the hash table goes back clean and the next query needn't zero it
+//
+// Author: Stew Forster (stew675@gmail.com)
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mincoins_int.h"
+
+#define SPARSE_MIN_SLOTS	1024U
+#define SPARSE_MAX_PRESIZE	(1U << 22)	// Most slots allocated up front from the estimate, ie. 32MiB
+#define SPARSE_CLEAR_RATIO	16		// Slots per used one, below which the whole table is cleared at once
+
+typedef struct slot {
+	uint32_t	total;
+	uint32_t	coin;		// Or 0 if the slot is empty
+} slot_t;
+
+typedef struct sparse {
+	minc_solver_t	*solver;
+	slot_t		*slots;
+	table_t		slots_table;
+	uint32_t	shift;		// 32 less log2 of the number of slots
+	uint32_t	mask;
+	uint32_t	used;
+	uint32_t	*queue;
+	table_t		queue_table;
+	uint32_t	queue_len;
+} sparse_t;
+
+
+// Fibonacci hashing spreads totals that are multiples of a coin, as they all are, evenly over the slots
+static inline slot_t *
+sparse_find(const sparse_t *sp, const uint32_t total)
+{
+	uint32_t i = (total * 2654435769U) >> sp->shift;
+
+	while ((sp->slots[i].coin != 0) && (sp->slots[i].total != total)) {
+		i = (i + 1) & sp->mask;
+	}
+	return &sp->slots[i];
+} // sparse_find
+
+
+// Make a hash table of n_slots slots, a power of 2, and move everything in the old one over, emptying it as it goes
+// so that it goes back to the pool clean.  Returns -1 if out of memory
+static int
+sparse_resize(sparse_t *sp, const uint64_t n_slots)
+{
+	sparse_t old = *sp;
+	uint32_t bits = 0;
+
+	for (; (1ULL << bits) < n_slots; bits++);
+	if ((bits > 32) ||
+	    ((sp->slots = solver_table_get(sp->solver, &sp->slots_table, sizeof(*sp->slots) << bits, 1)) == NULL)) {
+		sp->slots = old.slots;
+		sp->slots_table = old.slots_table;
+		return -1;
+	}
+	sp->shift = 32 - bits;
+	sp->mask = (uint32_t)((1ULL << bits) - 1);
+	for (uint64_t i = 0; old.slots && (i <= old.mask); i++) {
+		if (old.slots[i].coin != 0) {
+			*sparse_find(sp, old.slots[i].total) = old.slots[i];
+			old.slots[i] = (slot_t){ 0, 0 };
+		}
+	}
+	solver_table_put(sp->solver, &old.slots_table, 1, NULL);
+	return 0;
+} // sparse_resize
+
+
+// Double the queue, keeping the totals in it.  Returns -1 if out of memory
+static int
+sparse_grow_queue(sparse_t *sp)
+{
+	table_t table;
+	uint32_t *queue = solver_table_get(sp->solver, &table, (size_t)sp->queue_len * 2 * sizeof(*queue), 0);
+
+	if (queue == NULL) {
+		return -1;
+	}
+	memcpy(queue, sp->queue, (size_t)sp->queue_len * sizeof(*queue));
+	solver_table_put(sp->solver, &sp->queue_table, 0, NULL);
+	sp->queue = queue;
+	sp->queue_table = table;
+	sp->queue_len *= 2;
+	return 0;
+} // sparse_grow_queue
+
+
+// The search loop, as for bfs_search(), and likewise always inlined with a constant 'counting'.  The table is kept
+// at most half full.  Returns how many totals went through the queue, or 0 if out of memory
+static inline __attribute__((always_inline)) uint32_t
+sparse_search(const uint32_t coins[], const uint32_t n_coins, const uint32_t target, sparse_t *sp,
+	      const int counting, minc_stats_t *stats)
+{
+	uint64_t compares = 0, queue_hwm = 0, levels = 0;
+	uint32_t queue_pos, queue_max, level_end = 0;
+
+	sp->queue[0] = 0;
+	for (queue_pos = 0, queue_max = 1; queue_pos < queue_max; queue_pos++) {
+		if (counting) {
+			if (queue_pos == level_end) {
+				levels++;
+				level_end = queue_max;
+			}
+			(queue_max - queue_pos > queue_hwm) && (queue_hwm = queue_max - queue_pos);
+		}
+		for (uint32_t total, qpt = sp->queue[queue_pos], c = 0; c < n_coins; c++) {
+			slot_t *slot;
+
+			if (counting) {
+				compares++;
+			}
+			if ((total = qpt + coins[c]) > target) {
+				break;	// coins are sorted in order, no point in continuing this path
+			}
+			if ((slot = sparse_find(sp, total))->coin != 0) {
+				continue;
+			}
+			slot->total = total;
+			slot->coin = coins[c];
+
+			if ((queue_max == sp->queue_len) && (sparse_grow_queue(sp) < 0)) {
+				return 0;
+			}
+			sp->queue[queue_max++] = total;
+
+			if ((++sp->used > sp->mask / 2) && (sparse_resize(sp, ((uint64_t)sp->mask + 1) * 2) < 0)) {
+				return 0;
+			}
+			if (total == target) {
+				queue_pos = queue_max;
+				break;
+			}
+		}
+	}
+
+	if (counting) {
+		stats->compares += compares;
+		stats->enqueued += queue_max - 1;
+		stats->levels += levels;
+		(queue_hwm > stats->queue_hwm) && (stats->queue_hwm = queue_hwm);
+	}
+	return queue_max;
+} // sparse_search
+
+
+// Walk back from the span through the coin that first reached each total, then count in the leap's largest coins
+static int
+sparse_reconstruct(minc_solver_t *solver, const sparse_t *sp, const uint32_t coins[], const uint32_t n_coins,
+		   const uint32_t span, const uint32_t leap, minc_result_t *result)
+{
+	if (((span > 0) && (sparse_find(sp, span)->coin == 0)) || ((span == 0) && (leap == 0))) {
+		return 0;
+	}
+	if (result_begin(solver, result, coins, n_coins) < 0) {
+		return -1;
+	}
+	for (uint32_t coin, run, total = span; total > 0; result_add(result, coin, run)) {
+		coin = sparse_find(sp, total)->coin;
+		for (run = 0; (total > 0) && (sparse_find(sp, total)->coin == coin); total -= coin, run++);
+	}
+	leap && (result->runs[n_coins - 1].count += leap / coins[n_coins - 1]);
+	return 0;
+} // sparse_reconstruct
+
+
+// Sparse breadth-first search engine.  The tables are sized from the coin set's estimate of how many totals can be
+// made, and grown as need be
+int
+minc_solve_sparse(minc_solver_t *solver, const uint32_t coins[], uint32_t n_coins, const uint32_t target,
+		  minc_result_t *result, minc_stats_t *stats)
+{
+	uint64_t faults = stats ? get_minor_faults() : 0, expect;
+	uint32_t leap, span, n_queued = 0;
+	sparse_t sp = { .solver = solver };
+	phase_mark_t mark;
+	prep_t prep;
+	int ret;
+
+	memset(result, 0, sizeof(*result));
+	result->target = target;
+
+	if ((ret = coins_prepare(&coins, &n_coins, target, &prep, stats)) <= 0) {
+		goto cleanup;
+	}
+	ret = -1;
+	leap = prep.leap;
+	span = prep.target - leap;
+
+	expect = coinset_reachable(prep.set, span);
+	(expect > SPARSE_MAX_PRESIZE / 2) && (expect = SPARSE_MAX_PRESIZE / 2);
+	sp.queue_len = (expect > SPARSE_MIN_SLOTS) ? expect : SPARSE_MIN_SLOTS;
+	if ((sparse_resize(&sp, 2 * sp.queue_len) < 0) ||
+	    ((sp.queue = solver_table_get(solver, &sp.queue_table, sp.queue_len * sizeof(*sp.queue), 0)) == NULL)) {
+		fprintf(stderr, "Line %d in %s:%s(): Out of memory\n", __LINE__, __FILE__, __func__);
+		goto cleanup;
+	}
+
+	phase_begin(stats, &mark);
+	if (stats) {
+		n_queued = sparse_search(coins, n_coins, span, &sp, 1, stats);
+	} else {
+		n_queued = sparse_search(coins, n_coins, span, &sp, 0, NULL);
+	}
+	phase_end(stats, MINC_PHASE_SEARCH, &mark);
+	if (n_queued == 0) {
+		fprintf(stderr, "Line %d in %s:%s(): Out of memory\n", __LINE__, __FILE__, __func__);
+		goto cleanup;
+	}
+
+	phase_begin(stats, &mark);
+	if (sparse_reconstruct(solver, &sp, coins, n_coins, span, leap, result) < 0) {
+		goto cleanup;
+	}
+	result_end(result, prep.set->gcd);
+	phase_end(stats, MINC_PHASE_RECONSTRUCT, &mark);
+	ret = 0;
+
+cleanup:
+	coins_release(&prep);
+
+	// Every total but zero that went through the queue has a slot.  Unless so few of them were used that a pass over
+	// the whole table would cost more, find them all before emptying any, as emptying one can hide those probed past
+	// it.  A search that ran out of memory may have filled a slot it didn't queue, so its table goes back as it is
+	if (solver && (n_queued > 0) && ((uint64_t)n_queued * SPARSE_CLEAR_RATIO > (uint64_t)sp.mask + 1)) {
+		memset(sp.slots, 0, ((size_t)sp.mask + 1) * sizeof(*sp.slots));
+	} else if (solver) {
+		for (uint32_t q = 1; q < n_queued; q++) {
+			sp.queue[q] = sparse_find(&sp, sp.queue[q]) - sp.slots;
+		}
+		for (uint32_t q = 1; q < n_queued; q++) {
+			sp.slots[sp.queue[q]] = (slot_t){ 0, 0 };
+		}
+	}
+	solver_table_put(solver, &sp.slots_table, solver && (n_queued > 0), stats);
+	solver_table_put(solver, &sp.queue_table, 0, stats);
+	if (stats) {
+		stats->queries++;
+		stats->pages += get_minor_faults() - faults;
+	}
+	return ret;
+} // minc_solve_sparse
@@ -0,0 +1,413 @@
+// On-disk table store
+//
+// Short-lived jobs on the same coin set would otherwise each build the same table.  With a store directory set,
+// every table built is kept there as a file that can be mapped straight back in, one per normalised coin set, named
+// by its fingerprint.  A file holds a header and the coins it was built for, and then the table itself from the
+// first page boundary on.  The table is in units of the coin set's gcd, so it serves every multiple of the set too.
+//
+// A table wanted beyond what the file covers is extended from where the file leaves off rather than built again,
+// into a partial file alongside that is then renamed over the old one, so that readers only ever map a complete
+// table.  Builders of the same set take turns by a lock on a third file, so that the second to arrive maps what the
+// first built rather than building it too.
+//
+// A long build can also be checkpointed.  Every so often the partial file is synced out as far as the table is
+// settled, and only then is its header updated to say so.  A build that's killed part way leaves the partial file
+// behind, and the next build of the set carries on from its last checkpoint.  The window of counts that the dynamic
+// programming needs to carry on is recovered from the table itself, so nothing else needs saving.
+//
+// A table too big to sit comfortably in memory is built out of core.  Only the dynamic programming's window and a
+// segment of the table are kept in memory, and each segment is written out in turn, bypassing the page cache where
+// the file system allows.  The file format is the same, and finished segments are read through the mapping as ever
+//
+// Author: Stew Forster (stew675@gmail.com)
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+
+#include "mincoins_int.h"
+
+#define STORE_MAGIC	"MINCTBL1"
+#define STORE_VERSION	2
+
+// An out-of-core build writes the table out in segments of this many totals, ie. 64MiB, from a buffer aligned for
+// direct I/O
+#define STORE_SEGMENT	(16U << 20)
+#define STORE_ALIGN	4096U
+
+typedef struct store_header {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	n_coins;
+	uint64_t	fingerprint;
+	uint32_t	span;		// The table covers totals 0 to span, in units of the coin set's gcd
+	uint32_t	offset;		// Of the table from the start of the file
+	uint32_t	done;		// Every total up to here is final.  Short of span only in a checkpoint
+	uint32_t	pad;
+	uint32_t	coins[];
+} store_header_t;
+
+const char *minc_store_dir = NULL;
+uint32_t minc_checkpoint_secs = 0;
+int minc_out_of_core = 0;
+
+
+// Keep built tables in the named directory, which is created if need be.  Returns -1 if it can't be used
+int
+minc_set_store_dir(const char *path)
+{
+	struct stat st;
+
+	if ((mkdir(path, 0777) < 0) && (errno != EEXIST)) {
+		fprintf(stderr, "Error: unable to create table store %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	if ((stat(path, &st) < 0) || !S_ISDIR(st.st_mode) || (access(path, R_OK | W_OK | X_OK) < 0)) {
+		fprintf(stderr, "Error: table store %s is not a usable directory\n", path);
+		return -1;
+	}
+	minc_store_dir = path;
+	return 0;
+} // minc_set_store_dir
+
+
+static size_t
+store_offset(const uint32_t n_coins)
+{
+	size_t page = sysconf(_SC_PAGESIZE);
+
+	return (sizeof(store_header_t) + (n_coins * sizeof(uint32_t)) + page - 1) & ~(page - 1);
+} // store_offset
+
+
+static void
+store_table(table_t *table, void *map, const size_t len)
+{
+	const store_header_t *hdr = map;
+
+	memset(table, 0, sizeof(*table));
+	table->kind = TABLE_FILE;
+	table->map = map;
+	table->map_len = len;
+	table->base = (uint8_t *)map + hdr->offset;
+	table->size = ((size_t)hdr->span + 1) * sizeof(uint32_t);
+} // store_table
+
+
+// Map a stored table, or a checkpoint of one, if there's one and it was built for exactly these coins.  Returns
+// its header, or NULL if there's no usable one
+static store_header_t *
+store_map(const char *path, const minc_coinset_t *set, table_t *table, const int writable)
+{
+	store_header_t *hdr;
+	struct stat st;
+	void *map;
+	int fd;
+
+	if ((fd = open(path, (writable ? O_RDWR : O_RDONLY) | O_CLOEXEC)) < 0) {
+		return NULL;
+	}
+	if ((fstat(fd, &st) < 0) || (st.st_size < (off_t)store_offset(set->n_coins)) ||
+	    ((map = mmap(NULL, st.st_size, PROT_READ | (writable ? PROT_WRITE : 0), MAP_SHARED, fd, 0)) == MAP_FAILED)) {
+		close(fd);
+		return NULL;
+	}
+	close(fd);
+
+	hdr = map;
+	if (memcmp(hdr->magic, STORE_MAGIC, sizeof(hdr->magic)) || (hdr->version != STORE_VERSION) ||
+	    (hdr->fingerprint != set->fingerprint) || (hdr->n_coins != set->n_coins) ||
+	    memcmp(hdr->coins, set->coins, set->n_coins * sizeof(*set->coins)) ||
+	    (hdr->offset != store_offset(set->n_coins)) || (hdr->done > hdr->span) ||
+	    ((uint64_t)st.st_size < hdr->offset + (((uint64_t)hdr->span + 1) * sizeof(uint32_t)))) {
+		fprintf(stderr, "Warning: ignoring stored table %s, which doesn't match its coin set\n", path);
+		munmap(map, st.st_size);
+		return NULL;
+	}
+	store_table(table, map, st.st_size);
+	return hdr;
+} // store_map
+
+
+// Find a stored table for the coin set that covers span.  If there's none, a new one is set up to cover at least
+// span, with as much of it as was stored already carried over, and store->have says how much that is.  That's taken
+// from a checkpoint left by a builder that didn't finish, if one got further than the last table stored.  The table
+// must then be filled in out to store->span, and passed to store_publish(), or store_abort() if that fails.  Returns
+// the table, or NULL if the store can't be used, in which case the caller just builds the table in memory
+uint32_t *
+store_open(store_t *store, const minc_coinset_t *set, const uint32_t span, table_t *table)
+{
+	size_t offset = store_offset(set->n_coins), len;
+	store_header_t *hdr, *part;
+	table_t old = {0};
+	uint32_t have;
+	void *map;
+	int fd;
+
+	memset(store, 0, sizeof(*store));
+	store->lock_fd = -1;
+	snprintf(store->path, sizeof(store->path), "%s/%016lx.tbl", minc_store_dir, (unsigned long)set->fingerprint);
+	if (((hdr = store_map(store->path, set, table, 0)) != NULL) && (hdr->span >= span)) {
+		return table->base;
+	}
+	table_free(table, NULL);
+
+	// Wait for anyone else building this table, and look again, since they may just have built what we need
+	snprintf(store->tmp, sizeof(store->tmp), "%s/%016lx.lock", minc_store_dir, (unsigned long)set->fingerprint);
+	if ((store->lock_fd = open(store->tmp, O_RDWR | O_CREAT | O_CLOEXEC, 0666)) < 0) {
+		fprintf(stderr, "Warning: unable to lock the table store: %s\n", strerror(errno));
+		return NULL;
+	}
+	while ((flock(store->lock_fd, LOCK_EX) < 0) && (errno == EINTR));
+	hdr = store_map(store->path, set, &old, 0);
+	have = hdr ? hdr->span : 0;
+	if (hdr && (have >= span)) {
+		store_abort(store);
+		*table = old;
+		return table->base;
+	}
+
+	snprintf(store->tmp, sizeof(store->tmp), "%s/%016lx.part", minc_store_dir, (unsigned long)set->fingerprint);
+	if (((part = store_map(store->tmp, set, table, 1)) != NULL) && (part->done > have)) {
+		// Carry on from the checkpoint, over as much as it was meant to cover if that's further
+		table_free(&old, NULL);
+		store->span = (part->span > span) ? part->span : span;
+		store->have = store->resumed = part->done;
+		if (store->span > part->span) {
+			table_free(table, NULL);
+			part = NULL;
+		}
+	} else {
+		table_free(table, NULL);
+		part = NULL;
+		store->span = span;
+		store->have = have;
+	}
+
+	if (part == NULL) {
+		len = offset + (((size_t)store->span + 1) * sizeof(uint32_t));
+		if (((fd = open(store->tmp, O_RDWR | O_CREAT | O_CLOEXEC, 0666)) < 0) ||
+		    ((store->have == have) && (ftruncate(fd, 0) < 0)) || (ftruncate(fd, len) < 0) ||
+		    ((map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)) {
+			fprintf(stderr, "Warning: unable to write to the table store: %s\n", strerror(errno));
+			if (fd >= 0) {
+				close(fd);
+			}
+			table_free(&old, NULL);
+			store_abort(store);
+			return NULL;
+		}
+		close(fd);
+
+		part = map;
+		if (store->have == have) {
+			memcpy(part->magic, STORE_MAGIC, sizeof(part->magic));
+			part->version = STORE_VERSION;
+			part->n_coins = set->n_coins;
+			part->fingerprint = set->fingerprint;
+			part->offset = offset;
+			part->done = 0;
+			memcpy(part->coins, set->coins, set->n_coins * sizeof(*set->coins));
+		}
+		part->span = store->span;
+		store_table(table, map, len);
+
+		// Carry over whatever was stored before
+		if ((store->have == have) && (have > 0)) {
+			memcpy(table->base, old.base, ((size_t)have + 1) * sizeof(uint32_t));
+		}
+	}
+	table_free(&old, NULL);
+	store->table = table;
+	store->building = 1;
+
+	// A table that would crowd out everything else in memory is built out of core
+	store->streaming = minc_out_of_core ||
+			   (table->size > ((uint64_t)sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE)) / 2);
+	return table->base;
+} // store_open
+
+
+// Write a segment of the table out.  Segments wholly beyond what the table had to start with are written directly
+// if they can be, since none of their pages have been read into the mapping.  Anything else is written through the
+// page cache, and then synced and dropped from it, so that it doesn't build up a table's worth of dirty pages
+static int
+store_write(void *arg, const uint64_t first, const uint32_t n, const uint32_t *buf)
+{
+	store_t *store = arg;
+	size_t len = (size_t)n * sizeof(*buf), done;
+	off_t pos = ((uint8_t *)store->table->base - (uint8_t *)store->table->map) + (first * sizeof(*buf));
+	int direct = (store->direct_fd >= 0) && (first > store->have) && ((len % STORE_ALIGN) == 0);
+	int fd = direct ? store->direct_fd : store->fd;
+	ssize_t ret;
+
+	for (done = 0; done < len; done += ret) {
+		if ((ret = pwrite(fd, (const uint8_t *)buf + done, len - done, pos + done)) < 0) {
+			if (errno == EINTR) {
+				ret = 0;
+				continue;
+			}
+			fprintf(stderr, "Warning: unable to write to the table store: %s\n", strerror(errno));
+			return -1;
+		}
+	}
+	if (!direct) {
+		sync_file_range(fd, pos, len, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+			        SYNC_FILE_RANGE_WAIT_AFTER);
+		posix_fadvise(fd, pos, len, POSIX_FADV_DONTNEED);
+	}
+	return 0;
+} // store_write
+
+
+// Fill in the table out of core, from store->have out to store->span.  The table being built can still be read
+// through its mapping up to upto.  Returns -1 if out of memory or if the table can't be written
+int
+store_stream(store_t *store, const uint32_t coins[], const uint32_t n_coins, uint32_t *upto, minc_stats_t *stats)
+{
+	void *buf = NULL;
+	int ret = -1;
+
+	if ((store->fd = open(store->tmp, O_WRONLY | O_CLOEXEC)) < 0) {
+		fprintf(stderr, "Warning: unable to write to the table store: %s\n", strerror(errno));
+		return -1;
+	}
+	store->direct_fd = open(store->tmp, O_WRONLY | O_CLOEXEC | O_DIRECT);
+
+	if (posix_memalign(&buf, STORE_ALIGN, (size_t)STORE_SEGMENT * sizeof(uint32_t)) != 0) {
+		fprintf(stderr, "Line %d in %s:%s(): Out of memory\n", __LINE__, __FILE__, __func__);
+	} else {
+		ret = dp_stream(coins, n_coins, store->table->base, store->have, store->span, buf, STORE_SEGMENT,
+				store_write, store, upto, stats);
+	}
+	free(buf);
+	(store->direct_fd >= 0) && close(store->direct_fd);
+	close(store->fd);
+	return ret;
+} // store_stream
+
+
+// Make sure the table is on disk up to upto, and only then mark the checkpoint as getting that far
+static void
+store_sync(store_t *store, const uint32_t upto)
+{
+	store_header_t *hdr = store->table->map;
+	size_t len = ((uint8_t *)store->table->base - (uint8_t *)hdr) + (((size_t)upto + 1) * sizeof(uint32_t));
+
+	if ((upto > hdr->done) && (msync(hdr, len, MS_SYNC) == 0)) {
+		hdr->done = upto;
+		msync(hdr, hdr->offset, MS_SYNC);
+	}
+} // store_sync
+
+
+static void *
+store_checkpointer(void *arg)
+{
+	store_t *store = arg;
+	struct timespec when;
+
+	minc_trace_thread_name("checkpointer");
+	pthread_mutex_lock(&store->lock);
+	while (!store->stop) {
+		clock_gettime(CLOCK_REALTIME, &when);
+		when.tv_sec += minc_checkpoint_secs;
+		while (!store->stop && (pthread_cond_timedwait(&store->wake, &store->lock, &when) != ETIMEDOUT));
+		if (!store->stop) {
+			uint64_t start = minc_now_ns();
+			uint32_t upto = __atomic_load_n(store->upto, __ATOMIC_ACQUIRE);
+
+			pthread_mutex_unlock(&store->lock);
+			store_sync(store, upto);
+			if (minc_tracing) {
+				minc_trace_span("checkpoint", "io", start, minc_now_ns(), "upto", upto);
+			}
+			pthread_mutex_lock(&store->lock);
+		}
+	}
+	pthread_mutex_unlock(&store->lock);
+	return NULL;
+} // store_checkpointer
+
+
+// While the table is filled in, write out everything up to upto every minc_checkpoint_secs seconds, so that a build
+// that's cut short can be carried on from there by the next one.  Entries up to upto must never be written again
+void
+store_checkpoints(store_t *store, uint32_t *upto)
+{
+	if (!store->building || (minc_checkpoint_secs == 0)) {
+		return;
+	}
+	store->upto = upto;
+	store->stop = 0;
+	pthread_mutex_init(&store->lock, NULL);
+	pthread_cond_init(&store->wake, NULL);
+	if (pthread_create(&store->checkpointer, NULL, store_checkpointer, store) != 0) {
+		fprintf(stderr, "Warning: unable to start checkpointing the table build\n");
+		pthread_cond_destroy(&store->wake);
+		pthread_mutex_destroy(&store->lock);
+		return;
+	}
+	store->checkpointing = 1;
+} // store_checkpoints
+
+
+static void
+store_stop(store_t *store)
+{
+	if (store->checkpointing) {
+		pthread_mutex_lock(&store->lock);
+		store->stop = 1;
+		pthread_cond_signal(&store->wake);
+		pthread_mutex_unlock(&store->lock);
+		pthread_join(store->checkpointer, NULL);
+		pthread_cond_destroy(&store->wake);
+		pthread_mutex_destroy(&store->lock);
+		store->checkpointing = 0;
+	}
+} // store_stop
+
+
+// Write the newly built table out, and put it in place of the old one.  Returns -1 if that fails, although the
+// table is still good to use
+int
+store_publish(store_t *store, table_t *table)
+{
+	store_header_t *hdr = table->map;
+	int ret = 0;
+
+	store_stop(store);
+	hdr->done = hdr->span;
+	if ((msync(table->map, table->map_len, MS_SYNC) < 0) || (rename(store->tmp, store->path) < 0)) {
+		fprintf(stderr, "Warning: unable to save the table to the store: %s\n", strerror(errno));
+		ret = -1;
+	}
+	store->building = 0;
+	store_abort(store);
+	return ret;
+} // store_publish
+
+
+// Give up on building a table, and let the next builder in.  Whatever was checkpointed is left for it to carry on
+// from
+void
+store_abort(store_t *store)
+{
+	store_stop(store);
+	store->building = 0;
+	if (store->lock_fd >= 0) {
+		close(store->lock_fd);
+		store->lock_fd = -1;
+	}
+} // store_abort
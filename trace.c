@@ -0,0 +1,107 @@
+// Optional Chrome trace-event output, for viewing in chrome://tracing or the Perfetto UI
+//
+// Spans are written as complete ("X") events as soon as they end, under a single lock.  That is far too slow for
+// anything but diagnosis, which is why tracing is strictly opt-in and every call site tests minc_tracing first
+//
+// Author: Stew Forster (stew675@gmail.com)
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+#include "mincoins.h"
+
+int minc_tracing = 0;
+
+static FILE *trace_fp = NULL;
+static uint64_t trace_epoch = 0;
+static uint32_t trace_events = 0;
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread pid_t trace_tid = 0;
+
+
+static inline pid_t
+get_tid(void)
+{
+	(trace_tid == 0) && (trace_tid = (pid_t)syscall(SYS_gettid));
+	return trace_tid;
+} // get_tid
+
+
+// Start writing trace events to the given file.  Returns -1 if it couldn't be created
+int
+minc_trace_open(const char *path)
+{
+	if ((trace_fp = fopen(path, "w")) == NULL) {
+		perror(path);
+		return -1;
+	}
+
+	trace_epoch = minc_now_ns();
+	trace_events = 0;
+	fprintf(trace_fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	minc_tracing = 1;
+	minc_trace_thread_name("main");
+	return 0;
+} // minc_trace_open
+
+
+void
+minc_trace_close(void)
+{
+	if (trace_fp == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&trace_lock);
+	minc_tracing = 0;
+	fprintf(trace_fp, "\n]}\n");
+	fclose(trace_fp);
+	trace_fp = NULL;
+	pthread_mutex_unlock(&trace_lock);
+} // minc_trace_close
+
+
+// Label the calling thread in the timeline
+void
+minc_trace_thread_name(const char *name)
+{
+	if (!minc_tracing) {
+		return;
+	}
+
+	pthread_mutex_lock(&trace_lock);
+	if (trace_fp != NULL) {
+		fprintf(trace_fp, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+			trace_events++ ? ",\n" : "", (int)getpid(), (int)get_tid(), name);
+	}
+	pthread_mutex_unlock(&trace_lock);
+} // minc_trace_thread_name
+
+
+// Record a span that ran from start_ns to end_ns (as returned by minc_now_ns()) on the calling thread.  If arg_name
+// is not NULL then arg_val is attached to the span under that name
+void
+minc_trace_span(const char *name, const char *cat, uint64_t start_ns, uint64_t end_ns, const char *arg_name,
+		uint64_t arg_val)
+{
+	if (!minc_tracing) {
+		return;
+	}
+
+	pthread_mutex_lock(&trace_lock);
+	if (trace_fp != NULL) {
+		fprintf(trace_fp, "%s{\"ph\":\"X\",\"name\":\"%s\",\"cat\":\"%s\",\"pid\":%d,\"tid\":%d,"
+			"\"ts\":%.3f,\"dur\":%.3f", trace_events++ ? ",\n" : "", name, cat, (int)getpid(), (int)get_tid(),
+			(start_ns - trace_epoch) / 1e3, (end_ns - start_ns) / 1e3);
+		if (arg_name != NULL) {
+			fprintf(trace_fp, ",\"args\":{\"%s\":%lu}", arg_name, (unsigned long)arg_val);
+		}
+		fputc('}', trace_fp);
+	}
+	pthread_mutex_unlock(&trace_lock);
+} // minc_trace_span